@@ -0,0 +1,194 @@
+#include "AssetPack.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+const char ASSET_PACK_MAGIC[4] = { 'B', 'P', 'A', 'K' };
+const uint32_t ASSET_PACK_VERSION = 2;
+
+// the smallest index record, an empty name's length, offset, size and stamp
+const size_t ASSET_PACK_ENTRY_MIN_BYTES = sizeof(uint32_t) + 2 * sizeof(uint64_t) + sizeof(SourceStamp);
+
+AssetPack g_assetPack;
+
+AssetPack::AssetPack() : m_data(NULL), m_size(0), m_mapped(false)
+{
+#ifdef _WIN32
+    m_file = NULL;
+    m_mapping = NULL;
+#endif
+}
+
+AssetPack::~AssetPack()
+{
+    close();
+}
+
+bool AssetPack::open(const char *pack_path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(pack_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void *view = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    m_file = file;
+    m_mapping = mapping;
+    m_size = (size_t) size.QuadPart;
+#else
+    int file = ::open(pack_path, O_RDONLY);
+    if (file < 0) return false;
+    struct stat status;
+    void *view = NULL;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        m_size = (size_t) status.st_size;
+        view = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED) view = NULL;
+    }
+    // the mapping keeps the file alive on its own
+    ::close(file);
+#endif
+    m_data = (const unsigned char *) view;
+    m_mapped = true;
+
+    if (m_data == NULL || !parse()) {
+        std::cout << "Ignoring corrupt or outdated asset pack '" << pack_path << "'." << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool AssetPack::open_memory(const unsigned char *data, size_t size)
+{
+    close();
+    m_data = data;
+    m_size = size;
+    if (!parse()) {
+        std::cout << "Ignoring corrupt or outdated embedded asset pack." << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AssetPack::close()
+{
+    if (!m_mapped) m_data = NULL;
+    m_mapped = false;
+#ifdef _WIN32
+    if (m_data != NULL) UnmapViewOfFile(m_data);
+    if (m_mapping != NULL) CloseHandle((HANDLE) m_mapping);
+    if (m_file != NULL) CloseHandle((HANDLE) m_file);
+    m_file = NULL;
+    m_mapping = NULL;
+#else
+    if (m_data != NULL) munmap((void *) m_data, m_size);
+#endif
+    m_data = NULL;
+    m_size = 0;
+    m_entries.clear();
+}
+
+bool AssetPack::parse()
+{
+    // only the index is read here; blobs are not touched until someone asks for them
+    size_t offset = sizeof(ASSET_PACK_MAGIC) + 2 * sizeof(uint32_t);
+    uint32_t header[2];
+    if (m_size < offset || memcmp(m_data, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) != 0) return false;
+    memcpy(header, m_data + sizeof(ASSET_PACK_MAGIC), sizeof(header));
+    if (header[0] != ASSET_PACK_VERSION) return false;
+
+    // the count comes from the file, so it may not claim more entries than the bytes left could hold
+    if (header[1] > (m_size - offset) / ASSET_PACK_ENTRY_MIN_BYTES) return false;
+    m_entries.resize(header[1]);
+    for (AssetPackEntry &entry : m_entries) {
+        uint32_t length;
+        if (m_size - offset < sizeof(length)) return false;
+        memcpy(&length, m_data + offset, sizeof(length));
+        offset += sizeof(length);
+        if (m_size - offset < (size_t) length + 2 * sizeof(uint64_t) + sizeof(SourceStamp)) return false;
+        entry.name.assign((const char *) m_data + offset, length);
+        offset += length;
+        memcpy(&entry.offset, m_data + offset, sizeof(uint64_t));
+        memcpy(&entry.size, m_data + offset + sizeof(uint64_t), sizeof(uint64_t));
+        offset += 2 * sizeof(uint64_t);
+        memcpy(&entry.source, m_data + offset, sizeof(SourceStamp));
+        offset += sizeof(SourceStamp);
+        if (entry.offset > m_size || entry.size > m_size - entry.offset) return false;
+    }
+    return true;
+}
+
+bool AssetPack::find(const char *name, const unsigned char *&data, size_t &size) const
+{
+    for (const AssetPackEntry &entry : m_entries) {
+        if (entry.name != name) continue;
+        data = m_data + entry.offset;
+        size = (size_t) entry.size;
+        return true;
+    }
+    return false;
+}
+
+bool AssetPack::is_current(const char *name) const
+{
+    for (const AssetPackEntry &entry : m_entries) {
+        if (entry.name == name) return source_unchanged(name, entry.source);
+    }
+    return false;
+}
+
+bool AssetPack::write(const char *pack_path, const std::vector<std::string> &names, const std::vector<std::vector<unsigned char>> &blobs)
+{
+    FILE *file = fopen(pack_path, "wb");
+    if (file == NULL) {
+        std::cout << "Unable to write asset pack '" << pack_path << "'." << std::endl;
+        return false;
+    }
+
+    // the index size is known up front, so every offset can be laid out before writing
+    uint64_t offset = sizeof(ASSET_PACK_MAGIC) + 2 * sizeof(uint32_t);
+    for (const std::string &name : names) offset += sizeof(uint32_t) + name.size() + 2 * sizeof(uint64_t) + sizeof(SourceStamp);
+    std::vector<uint64_t> offsets;
+    for (const std::vector<unsigned char> &blob : blobs) {
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        offsets.push_back(offset);
+        offset += blob.size();
+    }
+
+    uint32_t header[2] = { ASSET_PACK_VERSION, (uint32_t) names.size() };
+    fwrite(ASSET_PACK_MAGIC, 1, sizeof(ASSET_PACK_MAGIC), file);
+    fwrite(header, sizeof(uint32_t), 2, file);
+    for (size_t i = 0; i < names.size(); i++) {
+        uint32_t length = (uint32_t) names[i].size();
+        uint64_t location[2] = { offsets[i], (uint64_t) blobs[i].size() };
+        SourceStamp source = { 0, 0, 0 };
+        stamp_source(names[i].c_str(), source, true);
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(names[i].data(), 1, length, file);
+        fwrite(location, sizeof(uint64_t), 2, file);
+        fwrite(&source, sizeof(source), 1, file);
+    }
+    const unsigned char padding[ASSET_PACK_ALIGNMENT] = {};
+    for (size_t i = 0; i < blobs.size(); i++) {
+        fwrite(padding, 1, (size_t) (offsets[i] - ftell(file)), file);
+        fwrite(blobs[i].data(), 1, blobs[i].size(), file);
+    }
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "SourceStamp.h"
+
+// where one asset sits inside the pack
+struct AssetPackEntry
+{
+    std::string name;
+    uint64_t offset;
+    uint64_t size;
+    SourceStamp source;     // the loose file the blob was packed from
+};
+
+// Read-only single-file archive of game assets, mapped into memory rather than read.
+// Every blob starts on an ASSET_PACK_ALIGNMENT boundary, so baked textures can be handed
+// to GL straight from the mapping. Entries are looked up by the path the loose file
+// would have had. Written by tools/pack_assets.cpp.
+//
+// layout: "BPAK", version, entry count, then per entry a length-prefixed name, offset, size
+// and source stamp, then the blobs
+class AssetPack
+{
+private:
+    const unsigned char *m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<AssetPackEntry> m_entries;
+
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#endif
+
+    bool parse();
+
+public:
+    static const size_t ASSET_PACK_ALIGNMENT = 16;
+
+    AssetPack();
+    ~AssetPack();
+
+    // a missing pack is not an error, callers fall back to loose files
+    bool open(const char *pack_path);
+    void close();
+
+    // uses a pack that is already in memory, e.g. compiled into the binary (see EmbeddedAssets.h)
+    bool open_memory(const unsigned char *data, size_t size);
+
+    bool find(const char *name, const unsigned char *&data, size_t &size) const;
+    // false once the loose file the entry was packed from has changed (see source_unchanged),
+    // so callers read that instead of a stale blob
+    bool is_current(const char *name) const;
+
+    // writes entries whose data the caller supplies, in order, stamping each with the loose
+    // file of the same name if there is one
+    static bool write(const char *pack_path, const std::vector<std::string> &names, const std::vector<std::vector<unsigned char>> &blobs);
+
+    bool const is_open() const { return m_data != NULL; };
+    size_t const get_size() const { return m_size; };
+    int const get_entry_count() const { return (int) m_entries.size(); };
+};
+
+extern AssetPack g_assetPack;
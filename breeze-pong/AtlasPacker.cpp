@@ -0,0 +1,412 @@
+#include "AtlasPacker.h"
+#include "ImageDecode.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+// transparent gap kept to the right of and below every region so nearest sampling never bleeds;
+// regions also start and end on 4 pixel boundaries so no BC1/BC3 block straddles two sprites
+const int ATLAS_PADDING = 1;
+const int ATLAS_ALIGNMENT = 4;
+
+// sprites are drawn with nearest filtering, which never samples below the top level, and lower
+// levels would blend neighbouring sprites together anyway, so only the top level is baked
+const int ATLAS_MIP_LEVELS = 1;
+const int ATLAS_CHANNELS = 4;
+
+// baked file layout: header, regions, entries (length-prefixed path, region and source stamp),
+// then either RGBA pixels or, for compressed atlases, each mip level as width, height, size and data
+const char ATLAS_MAGIC[4] = { 'B', 'P', 'A', 'T' };
+const uint32_t ATLAS_VERSION = 3;
+const int ATLAS_HEADER_SIZE = 7;
+
+// smallest possible record of each kind, for bounding counts read from a file
+const size_t ATLAS_REGION_BYTES = 4 * sizeof(int32_t);
+const size_t ATLAS_ENTRY_MIN_BYTES = 2 * sizeof(uint32_t) + sizeof(SourceStamp);
+const size_t ATLAS_LEVEL_MIN_BYTES = 3 * sizeof(uint32_t);
+
+uint32_t hash_pixels(const unsigned char *pixels, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= pixels[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool AtlasPacker::decode_image(const char *path, DecodedImage &image)
+{
+    // touches no packer state, so several decodes can run on worker threads at once
+    image.path = path;
+    return decode_image_pixels(path, image.pixels, image.width, image.height);
+}
+
+bool AtlasPacker::decode_image(const char *path, const unsigned char *data, size_t size, DecodedImage &image)
+{
+    image.path = path;
+    return decode_image_pixels(path, data, size, image.pixels, image.width, image.height);
+}
+
+int AtlasPacker::add_image(const char *path)
+{
+    for (const AtlasEntry &entry : m_entries) {
+        if (entry.path == path) return entry.region;
+    }
+
+    DecodedImage image;
+    if (!decode_image(path, image)) return -1;
+    return add_decoded(image);
+}
+
+int AtlasPacker::add_decoded(DecodedImage &image)
+{
+    for (const AtlasEntry &entry : m_entries) {
+        if (entry.path == image.path) return entry.region;
+    }
+    uint32_t hash = hash_pixels(image.pixels.data(), image.pixels.size());
+
+    // identical pixels under a different name reuse the existing region
+    int region = -1;
+    for (int i = 0; i < (int) m_regions.size(); i++) {
+        if (m_source_hashes[i] == hash && m_regions[i].width == image.width && m_regions[i].height == image.height &&
+            m_sources[i] == image.pixels) {
+            region = i;
+            break;
+        }
+    }
+
+    if (region == -1) {
+        region = (int) m_regions.size();
+        AtlasRegion placed = { 0, 0, image.width, image.height };
+        m_regions.push_back(placed);
+        m_sources.push_back(std::move(image.pixels));
+        m_source_hashes.push_back(hash);
+    }
+
+    AtlasEntry entry = { image.path, region, { 0, 0, 0 } };
+    m_entries.push_back(entry);
+    return region;
+}
+
+int padded_size(int size)
+{
+    return (size + ATLAS_PADDING + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+}
+
+int AtlasPacker::shelf_pack(int atlas_width, const std::vector<int> &order, std::vector<AtlasRegion> &placed) const
+{
+    int shelf_y = 0, shelf_x = 0, shelf_height = 0;
+    for (int index : order) {
+        AtlasRegion region = m_regions[index];
+        int padded_width  = padded_size(region.width);
+        int padded_height = padded_size(region.height);
+
+        if (shelf_x + padded_width > atlas_width) {
+            shelf_y += shelf_height;
+            shelf_x = 0;
+            shelf_height = 0;
+        }
+        region.x = shelf_x;
+        region.y = shelf_y;
+        placed[index] = region;
+
+        shelf_x += padded_width;
+        shelf_height = std::max(shelf_height, padded_height);
+    }
+    return shelf_y + shelf_height;
+}
+
+void AtlasPacker::pack()
+{
+    // tallest first keeps shelves tight
+    std::vector<int> order(m_regions.size());
+    for (int i = 0; i < (int) order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_regions[a].height > m_regions[b].height;
+    });
+
+    // try a few widths and keep whichever wastes the least area
+    int widest = 0;
+    size_t area = 0;
+    for (const AtlasRegion &region : m_regions) {
+        widest = std::max(widest, padded_size(region.width));
+        area += (size_t) padded_size(region.width) * padded_size(region.height);
+    }
+    int square = padded_size((int) std::ceil(std::sqrt((double) area)) - ATLAS_PADDING);
+    std::vector<int> candidates = { widest, std::max(widest, square) };
+    for (const AtlasRegion &region : m_regions) candidates.push_back(widest + padded_size(region.width));
+
+    std::vector<AtlasRegion> best, placed(m_regions.size());
+    size_t best_area = 0;
+    for (int width : candidates) {
+        int height = shelf_pack(width, order, placed);
+        if (best.empty() || (size_t) width * height < best_area) {
+            best = placed;
+            best_area = (size_t) width * height;
+            m_width = width;
+            m_height = height;
+        }
+    }
+    m_regions = best;
+
+    // blit every source into place, rows stay top-down like stbi_load output
+    m_storage.assign((size_t) m_width * m_height * ATLAS_CHANNELS, 0);
+    m_pixels = m_storage.data();
+    for (int i = 0; i < (int) m_regions.size(); i++) {
+        const AtlasRegion &region = m_regions[i];
+        size_t row_bytes = (size_t) region.width * ATLAS_CHANNELS;
+        for (int row = 0; row < region.height; row++) {
+            memcpy(&m_storage[((size_t) (region.y + row) * m_width + region.x) * ATLAS_CHANNELS],
+                   &m_sources[i][row * row_bytes], row_bytes);
+        }
+    }
+    m_sources.clear();
+    m_source_hashes.clear();
+}
+
+void append_bytes(std::vector<unsigned char> &out, const void *data, size_t size)
+{
+    out.insert(out.end(), (const unsigned char *) data, (const unsigned char *) data + size);
+}
+
+void AtlasPacker::serialize(std::vector<unsigned char> &out) const
+{
+    uint32_t header[ATLAS_HEADER_SIZE] = { ATLAS_VERSION, (uint32_t) m_width, (uint32_t) m_height,
+                                           (uint32_t) m_regions.size(), (uint32_t) m_entries.size(),
+                                           (uint32_t) m_format, (uint32_t) m_levels.size() };
+    out.clear();
+    append_bytes(out, ATLAS_MAGIC, sizeof(ATLAS_MAGIC));
+    append_bytes(out, header, sizeof(header));
+    for (const AtlasRegion &region : m_regions) {
+        int32_t rect[4] = { region.x, region.y, region.width, region.height };
+        append_bytes(out, rect, sizeof(rect));
+    }
+    for (const AtlasEntry &entry : m_entries) {
+        // stamped as the atlas is written, so a bake always records the files it was made from
+        uint32_t length = (uint32_t) entry.path.size();
+        uint32_t region = (uint32_t) entry.region;
+        SourceStamp source = { 0, 0, 0 };
+        if (!stamp_source(entry.path.c_str(), source, true)) source = entry.source;
+        append_bytes(out, &length, sizeof(length));
+        append_bytes(out, entry.path.data(), length);
+        append_bytes(out, &region, sizeof(region));
+        append_bytes(out, &source, sizeof(source));
+    }
+    if (m_format == TEXTURE_FORMAT_RGBA8) append_bytes(out, m_pixels, get_atlas_bytes());
+    for (const TextureLevel &level : m_levels) {
+        uint32_t size[3] = { (uint32_t) level.width, (uint32_t) level.height, (uint32_t) level.size };
+        append_bytes(out, size, sizeof(size));
+        append_bytes(out, level.data, level.size);
+    }
+}
+
+bool AtlasPacker::save(const char *atlas_path) const
+{
+    FILE *file = fopen(atlas_path, "wb");
+    if (file == NULL) {
+        std::cout << "Unable to write atlas '" << atlas_path << "'." << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> contents;
+    serialize(contents);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+    return true;
+}
+
+bool AtlasPacker::load_baked(const char *atlas_path)
+{
+    // a missing file is expected, the caller falls back to packing at runtime
+    FILE *file = fopen(atlas_path, "rb");
+    if (file == NULL) return false;
+
+    // read it whole, the pixels are then used in place
+    std::vector<unsigned char> contents;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    contents.resize(size > 0 ? (size_t) size : 0);
+    bool valid = fread(contents.data(), 1, contents.size(), file) == contents.size();
+    fclose(file);
+
+    valid = valid && load_baked(contents.data(), contents.size());
+    if (!valid) {
+        std::cout << "Ignoring corrupt or outdated atlas '" << atlas_path << "'." << std::endl;
+        *this = AtlasPacker();
+        return false;
+    }
+    m_storage.swap(contents);
+    return true;
+}
+
+// bounds-checked cursor over a baked atlas in memory
+struct BakedReader
+{
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+
+    const unsigned char *take(size_t bytes)
+    {
+        if (bytes > size - offset) return NULL;
+        offset += bytes;
+        return data + offset - bytes;
+    }
+
+    bool read(void *out, size_t bytes)
+    {
+        const unsigned char *source = take(bytes);
+        if (source != NULL) memcpy(out, source, bytes);
+        return source != NULL;
+    }
+};
+
+bool AtlasPacker::load_baked(const unsigned char *data, size_t size)
+{
+    // regions and paths are copied out, the pixel data is only pointed at
+    BakedReader reader = { data, size, 0 };
+    char magic[4];
+    uint32_t header[ATLAS_HEADER_SIZE];
+    bool valid = reader.read(magic, sizeof(magic)) &&
+                 memcmp(magic, ATLAS_MAGIC, sizeof(magic)) == 0 &&
+                 reader.read(header, sizeof(header)) &&
+                 header[0] == ATLAS_VERSION && header[5] <= TEXTURE_FORMAT_BC3;
+
+    // counts come from the file, so none may claim more records than the bytes left could hold
+    size_t remaining = size - reader.offset;
+    valid = valid && header[3] <= remaining / ATLAS_REGION_BYTES &&
+            header[4] <= (remaining - header[3] * ATLAS_REGION_BYTES) / ATLAS_ENTRY_MIN_BYTES &&
+            header[6] <= remaining / ATLAS_LEVEL_MIN_BYTES;
+
+    if (valid) {
+        m_baked  = true;
+        m_width  = (int) header[1];
+        m_height = (int) header[2];
+        m_regions.resize(header[3]);
+        m_entries.resize(header[4]);
+        for (AtlasRegion &region : m_regions) {
+            int32_t rect[4] = { 0, 0, 0, 0 };
+            valid = valid && reader.read(rect, sizeof(rect));
+            region = { rect[0], rect[1], rect[2], rect[3] };
+        }
+        for (AtlasEntry &entry : m_entries) {
+            uint32_t length = 0, region = 0;
+            const unsigned char *path = NULL;
+            valid = valid && reader.read(&length, sizeof(length)) && (path = reader.take(length)) != NULL &&
+                    reader.read(&region, sizeof(region)) && region < m_regions.size() &&
+                    reader.read(&entry.source, sizeof(entry.source));
+            if (valid) entry.path.assign((const char *) path, length);
+            entry.region = (int) region;
+        }
+        m_format = (TextureFormat) header[5];
+        if (m_format == TEXTURE_FORMAT_RGBA8) {
+            m_pixels = reader.take((size_t) m_width * m_height * ATLAS_CHANNELS);
+            valid = valid && m_pixels != NULL;
+        }
+        m_levels.resize(valid ? header[6] : 0);
+        for (TextureLevel &level : m_levels) {
+            uint32_t level_size[3] = { 0, 0, 0 };
+            valid = valid && reader.read(level_size, sizeof(level_size)) &&
+                    level_size[2] == texture_level_size(m_format, (int) level_size[0], (int) level_size[1]);
+            level.width = (int) level_size[0];
+            level.height = (int) level_size[1];
+            level.size = level_size[2];
+            level.data = valid ? reader.take(level.size) : NULL;
+            valid = valid && level.data != NULL;
+        }
+        valid = valid && (m_format == TEXTURE_FORMAT_RGBA8 || !m_levels.empty());
+    }
+
+    if (!valid) *this = AtlasPacker();
+    return valid;
+}
+
+bool AtlasPacker::contains(const char *path) const
+{
+    for (const AtlasEntry &entry : m_entries) {
+        if (entry.path == path) return true;
+    }
+    return false;
+}
+
+bool AtlasPacker::is_current(const char *path) const
+{
+    for (const AtlasEntry &entry : m_entries) {
+        if (entry.path == path) return source_unchanged(path, entry.source);
+    }
+    return false;
+}
+
+glm::vec4 AtlasPacker::get_uv_rect(const char *path) const
+{
+    for (const AtlasEntry &entry : m_entries) {
+        if (entry.path != path) continue;
+        const AtlasRegion &region = m_regions[entry.region];
+        return glm::vec4((float) region.x / m_width, (float) region.y / m_height,
+                         (float) region.width / m_width, (float) region.height / m_height);
+    }
+    std::cout << "Image '" << path << "' is not in the atlas." << std::endl;
+    assert(false);
+    return glm::vec4(0.0f);
+}
+
+void AtlasPacker::release_pixels(DecodedImage &image)
+{
+    image.path.clear();
+    image.width = m_width;
+    image.height = m_height;
+
+    // owned pixels move over, borrowed ones (e.g. from an asset pack) have to be copied
+    if (m_pixels != NULL && m_pixels == m_storage.data()) {
+        image.pixels = std::move(m_storage);
+    } else if (m_pixels != NULL) {
+        image.pixels.assign(m_pixels, m_pixels + get_atlas_bytes());
+    }
+    m_storage.clear();
+    m_pixels = NULL;
+}
+
+void AtlasPacker::compress()
+{
+    std::vector<unsigned char> storage;
+    m_format = choose_block_format(m_pixels, m_width, m_height);
+    build_mip_chain(m_pixels, m_width, m_height, m_format, ATLAS_MIP_LEVELS, storage, m_levels);
+    m_storage.swap(storage);
+    m_pixels = NULL;
+}
+
+void AtlasPacker::decompress()
+{
+    if (m_format == TEXTURE_FORMAT_RGBA8) return;
+    std::vector<unsigned char> pixels;
+    decompress_level(m_format, m_levels[0], pixels);
+    m_storage.swap(pixels);
+    m_pixels = m_storage.data();
+    m_levels.clear();
+    m_format = TEXTURE_FORMAT_RGBA8;
+}
+
+size_t AtlasPacker::get_atlas_bytes() const
+{
+    // what the texture occupies once uploaded
+    if (m_format == TEXTURE_FORMAT_RGBA8) return m_pixels != NULL ? (size_t) m_width * m_height * ATLAS_CHANNELS : 0;
+    size_t bytes = 0;
+    for (const TextureLevel &level : m_levels) bytes += level.size;
+    return bytes;
+}
+
+size_t AtlasPacker::get_separate_bytes() const
+{
+    // what the same images cost as one texture per path
+    size_t bytes = 0;
+    for (const AtlasEntry &entry : m_entries) {
+        bytes += (size_t) m_regions[entry.region].width * m_regions[entry.region].height * ATLAS_CHANNELS;
+    }
+    return bytes;
+}
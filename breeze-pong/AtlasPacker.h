@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "glm/vec4.hpp"
+#include "TextureCompression.h"
+#include "SourceStamp.h"
+
+// packed rectangle inside the atlas, in pixels
+struct AtlasRegion
+{
+    int x, y;
+    int width, height;
+};
+
+// maps a source image path to the region holding its pixels
+struct AtlasEntry
+{
+    std::string path;
+    int region;
+    SourceStamp source;     // the file the entry was baked from
+};
+
+// a source image decoded to RGBA, not yet placed in the atlas
+struct DecodedImage
+{
+    std::string path;
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+// Packs any number of images into a single RGBA texture. Images with the same path or
+// identical pixels share one region. The result can be baked to disk with save() and
+// read back with load_baked(), which skips PNG decoding and packing entirely. Baking
+// can also block-compress the atlas (see compress()).
+class AtlasPacker
+{
+private:
+    std::vector<AtlasEntry> m_entries;
+    std::vector<AtlasRegion> m_regions;
+
+    // decoded pixels per region, only kept until pack()
+    std::vector<std::vector<unsigned char>> m_sources;
+    std::vector<uint32_t> m_source_hashes;
+
+    // RGBA pixels, or the mip levels once compressed; both point into m_storage unless
+    // the atlas was loaded from memory someone else owns (see load_baked)
+    std::vector<unsigned char> m_storage;
+    const unsigned char *m_pixels = NULL;
+    std::vector<TextureLevel> m_levels;
+    TextureFormat m_format = TEXTURE_FORMAT_RGBA8;
+    int m_width = 0;
+    int m_height = 0;
+    bool m_baked = false;
+
+    int shelf_pack(int atlas_width, const std::vector<int> &order, std::vector<AtlasRegion> &placed) const;
+
+public:
+    // move-only, since the pixel pointers follow m_storage's buffer
+    AtlasPacker() = default;
+    AtlasPacker(AtlasPacker &&) = default;
+    AtlasPacker &operator=(AtlasPacker &&) = default;
+    AtlasPacker(const AtlasPacker &) = delete;
+    AtlasPacker &operator=(const AtlasPacker &) = delete;
+
+    // decode_image() is safe to call from any thread; add_decoded() takes the result
+    // on the packing thread. add_image() does both in one go.
+    static bool decode_image(const char *path, DecodedImage &image);
+    // decodes an encoded image held in memory, e.g. a PNG stored in the asset pack, as if read from path
+    static bool decode_image(const char *path, const unsigned char *data, size_t size, DecodedImage &image);
+    int add_decoded(DecodedImage &image);
+    int add_image(const char *path);
+    void pack();
+
+    // replaces the RGBA pixels with BC1/BC3 blocks; meant for the offline baker
+    void compress();
+
+    bool save(const char *atlas_path) const;
+    void serialize(std::vector<unsigned char> &out) const;
+    bool load_baked(const char *atlas_path);
+
+    // parses a baked atlas already in memory and uses its pixels in place; data must
+    // outlive the packer (e.g. a mapped AssetPack)
+    bool load_baked(const unsigned char *data, size_t size);
+
+    bool contains(const char *path) const;
+    // false once the source file differs from the one baked (see source_unchanged)
+    bool is_current(const char *path) const;
+    glm::vec4 get_uv_rect(const char *path) const;
+
+    // hands the packed RGBA pixels over (e.g. to an uploader thread) without copying them
+    void release_pixels(DecodedImage &image);
+
+    // expands the top mip level of a compressed atlas back to RGBA
+    void decompress();
+
+    size_t get_separate_bytes() const;
+    size_t get_atlas_bytes() const;
+
+    bool const is_baked()                 const { return m_baked;            };
+    int const get_width()                 const { return m_width;            };
+    int const get_height()                const { return m_height;           };
+    int const get_region_count()          const { return (int) m_regions.size(); };
+    int const get_entry_count()           const { return (int) m_entries.size(); };
+    const unsigned char *get_pixels()     const { return m_pixels;           };
+    TextureFormat const get_format()      const { return m_format;           };
+    const std::vector<TextureLevel> &get_levels() const { return m_levels; };
+};
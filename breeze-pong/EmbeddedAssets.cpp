@@ -0,0 +1,22 @@
+#include "EmbeddedAssets.h"
+
+#ifdef BREEZE_EMBED_ASSETS
+
+// defines EMBEDDED_ASSET_PACK, regenerate whenever the assets or shaders change
+#include "assets/embedded_pack.inc"
+
+const unsigned char *get_embedded_asset_pack(size_t &size)
+{
+    size = sizeof(EMBEDDED_ASSET_PACK);
+    return EMBEDDED_ASSET_PACK;
+}
+
+#else
+
+const unsigned char *get_embedded_asset_pack(size_t &size)
+{
+    size = 0;
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+
+// An asset pack compiled into the executable, so startup needs no asset files at all.
+// Generate the data with tools/embed_assets.cpp and build with BREEZE_EMBED_ASSETS
+// defined; without it this returns NULL and the game reads the pack or loose files.
+const unsigned char *get_embedded_asset_pack(size_t &size);
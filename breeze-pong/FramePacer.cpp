@@ -0,0 +1,241 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <ctime>
+#endif
+
+const char* const MODE_NAMES[FRAME_PACER_MODE_COUNT] = { "unlimited", "paced", "idle", "low latency" };
+
+// how quickly the refresh period estimate follows measured swap intervals, and how far off
+// a measurement may be before it is taken for noise
+const double REFRESH_SMOOTHING = 0.05;
+const double REFRESH_TOLERANCE = 0.1;
+
+// frames are started so that this fraction of recent frames would have finished in time
+const float COST_PERCENTILE = 0.9f;
+
+double process_cpu_seconds()
+{
+#ifdef _WIN32
+    // clock() is wall time on Windows, so ask for the kernel and user times directly
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    ULARGE_INTEGER kernel_time, user_time;
+    kernel_time.LowPart = kernel.dwLowDateTime;
+    kernel_time.HighPart = kernel.dwHighDateTime;
+    user_time.LowPart = user.dwLowDateTime;
+    user_time.HighPart = user.dwHighDateTime;
+    return (double) (kernel_time.QuadPart + user_time.QuadPart) / 10000000.0;   // 100 ns units
+#else
+    return (double) std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+FramePacer::FramePacer() : m_mode(FRAME_PACER_UNLIMITED), m_low_latency(false), m_period(0), m_spin(0), m_deadline(0), m_frequency(0),
+                           m_poll_interval(0), m_last_poll(0), m_refresh_period(0.0), m_margin(0), m_frame_start(0), m_frame_ready(0),
+                           m_missed_vblanks(0), m_report(false),
+                           m_report_interval(0.0f), m_last_frame(0), m_window_start(0), m_window_cpu_start(0.0),
+                           m_window_mode(FRAME_PACER_UNLIMITED)
+{
+}
+
+void FramePacer::load(int target_fps, float spin_ms, bool report, float report_interval)
+{
+    m_frequency = SDL_GetPerformanceFrequency();
+    m_period = target_fps > 0 ? m_frequency / target_fps : 0;
+    m_spin = (Uint64) (spin_ms * m_frequency / 1000.0f);
+    m_mode = m_period > 0 ? FRAME_PACER_PACED : FRAME_PACER_UNLIMITED;
+    m_report = report;
+    m_report_interval = report_interval;
+
+    m_deadline = SDL_GetPerformanceCounter();
+    m_last_frame = m_deadline;
+    m_window_start = m_deadline;
+    m_window_cpu_start = process_cpu_seconds();
+    m_window_mode = m_mode;
+}
+
+void FramePacer::start_low_latency(float refresh_hz, float margin_ms)
+{
+    m_low_latency = true;
+    m_refresh_period = m_frequency / refresh_hz;
+    m_margin = (Uint64) (margin_ms * m_frequency / 1000.0f);
+    m_mode = FRAME_PACER_LOW_LATENCY;
+    m_window_mode = m_mode;
+}
+
+void FramePacer::set_input_poll(int poll_hz)
+{
+    m_poll_interval = poll_hz > 0 ? m_frequency / poll_hz : 0;
+}
+
+void FramePacer::sleep_until(Uint64 deadline)
+{
+    // with input polling on, sleeps are cut into poll intervals
+    Uint64 now = SDL_GetPerformanceCounter();
+    while (now < deadline) {
+        if (m_poll_interval > 0 && now - m_last_poll >= m_poll_interval) {
+            SDL_PumpEvents();
+            m_last_poll = now;
+        }
+        Uint64 remaining = deadline - now;
+        if (remaining > m_spin) {
+            Uint64 sleep = remaining - m_spin;
+            if (m_poll_interval > 0) sleep = std::min(sleep, m_poll_interval);
+            SDL_Delay((Uint32) (sleep * 1000 / m_frequency));
+        } else {
+            std::this_thread::yield();
+        }
+        now = SDL_GetPerformanceCounter();
+    }
+}
+
+Uint64 FramePacer::predict_vblank(Uint64 after) const
+{
+    // a swap completes at or a little after a vblank, never before, so of the recent swaps
+    // projected forward on the refresh grid the earliest is the closest to the real one
+    Uint64 best = 0;
+    for (Uint64 swap : m_swaps) {
+        double periods = after > swap ? std::ceil((double) (after - swap) / m_refresh_period) : 0.0;
+        Uint64 vblank = swap + (Uint64) (periods * m_refresh_period);
+        if (best == 0 || vblank < best) best = vblank;
+    }
+    return best;
+}
+
+Uint64 FramePacer::estimate_cost() const
+{
+    if (m_costs.empty()) return 0;
+    std::vector<Uint64> costs(m_costs);
+    std::vector<Uint64>::iterator percentile = costs.begin() + (size_t) ((costs.size() - 1) * COST_PERCENTILE);
+    std::nth_element(costs.begin(), percentile, costs.end());
+    return *percentile;
+}
+
+void FramePacer::begin_frame()
+{
+    m_frame_start = SDL_GetPerformanceCounter();
+    if (!m_low_latency || m_swaps.empty()) return;
+
+    // aim for the first vblank a typical frame can still make, and start no earlier than needed
+    Uint64 lead = estimate_cost() + m_margin;
+    Uint64 vblank = predict_vblank(m_frame_start + lead);
+    sleep_until(vblank - lead);
+    m_frame_start = SDL_GetPerformanceCounter();
+}
+
+void FramePacer::mark_ready()
+{
+    m_frame_ready = SDL_GetPerformanceCounter();
+    m_costs.push_back(m_frame_ready - m_frame_start);
+    if ((int) m_costs.size() > COST_HISTORY) m_costs.erase(m_costs.begin());
+}
+
+void FramePacer::mark_presented()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    // refine the refresh period from back to back swaps; a gap of several periods is a missed
+    // vblank, unless the last frame idled
+    if (!m_swaps.empty()) {
+        double interval = (double) (now - m_swaps.back());
+        double periods = std::floor(interval / m_refresh_period + 0.5);
+        if (periods >= 1.0) {
+            double sample = interval / periods;
+            if (std::fabs(sample - m_refresh_period) < m_refresh_period * REFRESH_TOLERANCE) {
+                m_refresh_period += (sample - m_refresh_period) * REFRESH_SMOOTHING;
+            }
+            if (m_mode == FRAME_PACER_LOW_LATENCY) m_missed_vblanks += (int) periods - 1;
+        }
+    }
+    m_swaps.push_back(now);
+    if ((int) m_swaps.size() > SWAP_HISTORY) m_swaps.erase(m_swaps.begin());
+
+    // input was read at the start of the frame and the swap completing is the vblank it is shown at
+    if (m_report) m_latency_ms.push_back((float) (now - m_frame_start) * 1000.0f / m_frequency);
+}
+
+void FramePacer::wait()
+{
+    // low latency frames did their waiting in begin_frame()
+    if (m_low_latency) {
+        end_frame(FRAME_PACER_LOW_LATENCY);
+        return;
+    }
+
+    if (m_period > 0) {
+        // a frame that ran long moves the schedule instead of making the next ones rush to catch up
+        Uint64 now = SDL_GetPerformanceCounter();
+        m_deadline += m_period;
+        if (now > m_deadline) m_deadline = now;
+        sleep_until(m_deadline);
+    }
+    end_frame(m_period > 0 ? FRAME_PACER_PACED : FRAME_PACER_UNLIMITED);
+}
+
+void FramePacer::idle(Uint32 timeout_ms)
+{
+    SDL_WaitEventTimeout(NULL, (int) timeout_ms);
+
+    // pacing picks up from here rather than from before the wait
+    m_deadline = SDL_GetPerformanceCounter();
+    end_frame(FRAME_PACER_IDLE);
+}
+
+void FramePacer::end_frame(FramePacerMode mode)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    m_mode = mode;
+    if (!m_report) {
+        m_last_frame = now;
+        return;
+    }
+
+    // each report covers one mode, so switching modes closes the current one early
+    if (mode != m_window_mode) {
+        print_report(now);
+        m_window_mode = mode;
+    }
+    m_frame_ms.push_back((float) (now - m_last_frame) * 1000.0f / m_frequency);
+    m_last_frame = now;
+    if ((float) (now - m_window_start) / m_frequency >= m_report_interval) print_report(now);
+}
+
+void FramePacer::print_report(Uint64 now)
+{
+    double cpu = process_cpu_seconds();
+    double wall = (double) (now - m_window_start) / m_frequency;
+    if (!m_frame_ms.empty() && wall > 0.0) {
+        // jitter is the standard deviation of the frame times
+        double mean = 0.0, variance = 0.0;
+        for (float ms : m_frame_ms) mean += ms;
+        mean /= m_frame_ms.size();
+        for (float ms : m_frame_ms) variance += (ms - mean) * (ms - mean);
+        variance /= m_frame_ms.size();
+        float worst = *std::max_element(m_frame_ms.begin(), m_frame_ms.end());
+
+        std::cout << "pacer " << MODE_NAMES[m_window_mode] << ": " << m_frame_ms.size() << " frames in " << wall << " s, "
+                  << (cpu - m_window_cpu_start) / wall * 100.0 << "% cpu, frame " << mean << " ms, jitter " << std::sqrt(variance)
+                  << " ms, worst " << worst << " ms";
+        if (m_low_latency && !m_latency_ms.empty()) {
+            double latency = 0.0;
+            for (float ms : m_latency_ms) latency += ms;
+            std::cout << ", latency " << latency / m_latency_ms.size() << " ms (worst " << *std::max_element(m_latency_ms.begin(), m_latency_ms.end())
+                      << "), refresh " << m_frequency / m_refresh_period << " Hz, " << m_missed_vblanks << " missed vblanks";
+        }
+        std::cout << std::endl;
+    }
+    m_frame_ms.clear();
+    m_latency_ms.clear();
+    m_missed_vblanks = 0;
+    m_window_start = now;
+    m_window_cpu_start = cpu;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <SDL.h>
+#include <vector>
+
+enum FramePacerMode
+{
+    FRAME_PACER_UNLIMITED,  // no cap, only vsync (if any) holds frames back
+    FRAME_PACER_PACED,      // sleeps, then spins, until the next frame is due
+    FRAME_PACER_IDLE,       // blocked on the event queue because nothing on screen changes
+    FRAME_PACER_LOW_LATENCY,// starts each frame just in time to make the next vblank
+    FRAME_PACER_MODE_COUNT
+};
+
+// Holds the main loop to a target frame rate without pinning a core. SDL_Delay only
+// promises to sleep at least as long as asked and on some systems overshoots by a
+// millisecond or more, so it sleeps until spin_ms before the deadline and spins the
+// rest. idle() blocks on the event queue instead, for states where redrawing at full
+// rate shows nothing new. Frame times and process CPU use are collected per mode and
+// reported every few seconds when reporting is on.
+//
+// In low latency mode the wait moves to the start of the frame: the next vblank is
+// predicted from when recent swaps completed, and begin_frame() holds off reading input
+// until only the expected frame cost (plus a margin) is left before it, so input is as
+// fresh as possible when the frame reaches the screen.
+class FramePacer
+{
+private:
+    static const int SWAP_HISTORY = 16;
+    static const int COST_HISTORY = 32;
+
+    FramePacerMode m_mode;
+    bool m_low_latency;
+    Uint64 m_period;        // performance counter ticks per frame, 0 when uncapped
+    Uint64 m_spin;
+    Uint64 m_deadline;
+    Uint64 m_frequency;
+    Uint64 m_poll_interval; // pump events this often while waiting, 0 to leave it to the caller
+    Uint64 m_last_poll;
+
+    // low latency state: refresh period estimate, recent swap completions and frame costs
+    double m_refresh_period;
+    Uint64 m_margin;
+    std::vector<Uint64> m_swaps;
+    std::vector<Uint64> m_costs;
+    Uint64 m_frame_start;
+    Uint64 m_frame_ready;
+    int m_missed_vblanks;
+
+    bool m_report;
+    float m_report_interval;
+    Uint64 m_last_frame;
+    Uint64 m_window_start;
+    double m_window_cpu_start;
+    FramePacerMode m_window_mode;
+    std::vector<float> m_frame_ms;
+    std::vector<float> m_latency_ms;
+
+    void sleep_until(Uint64 deadline);
+    Uint64 predict_vblank(Uint64 after) const;
+    Uint64 estimate_cost() const;
+    void end_frame(FramePacerMode mode);
+    void print_report(Uint64 now);
+
+public:
+    FramePacer();
+
+    // target_fps 0 leaves the frame rate uncapped
+    void load(int target_fps, float spin_ms, bool report, float report_interval);
+    // refresh_hz seeds the vblank prediction until enough swaps have been timed; the caller
+    // sets up vsync and calls glFinish before mark_ready() and after the swap
+    void start_low_latency(float refresh_hz, float margin_ms);
+    // keeps pumping SDL events at poll_hz while waiting, so input is timestamped close to
+    // when it arrives rather than when the next frame starts
+    void set_input_poll(int poll_hz);
+
+    // call before reading input; only waits in low latency mode
+    void begin_frame();
+    // call with the frame's GPU work finished, just before the swap
+    void mark_ready();
+    // call once the swap has completed
+    void mark_presented();
+
+    // call once per frame, after presenting
+    void wait();
+    // in place of wait() while idle: returns after timeout_ms or as soon as an event arrives,
+    // leaving the event queued for the next processInput
+    void idle(Uint32 timeout_ms);
+
+    FramePacerMode const get_mode() const { return m_mode; };
+    bool const is_low_latency() const { return m_low_latency; };
+};
+
+// CPU time used by every thread of this process so far
+double process_cpu_seconds();
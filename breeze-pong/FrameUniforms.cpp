@@ -0,0 +1,39 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "FrameUniforms.h"
+
+static_assert(sizeof(FrameData) == 128, "FrameData must match the std140 layout of the shader block");
+
+void FrameUniforms::load()
+{
+    m_data.projection_matrix = glm::mat4(1.0f);
+    set_view_matrix(Transform2D(1.0f));
+    m_data.screen_size = glm::vec2(0.0f);
+    m_data.time = 0.0f;
+    m_data.padding = 0.0f;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), &m_data, GL_DYNAMIC_DRAW);
+
+    // the binding point never changes, so this is the only bind the buffer needs
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, m_buffer);
+}
+
+void FrameUniforms::set_view_matrix(const Transform2D &matrix)
+{
+    for (int column = 0; column < 3; column++) {
+        m_data.view_matrix[column] = glm::vec4(matrix[column], 0.0f, 0.0f);
+    }
+}
+
+void FrameUniforms::cleanup()
+{
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void FrameUniforms::upload()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &m_data);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifdef _WINDOWS
+    #include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "Transform2D.h"
+
+// binding point shared by every program's FrameData block
+const GLuint FRAME_UNIFORM_BINDING = 0;
+const char FRAME_UNIFORM_BLOCK[] = "FrameData";
+
+// mirrors the std140 FrameData block declared in the vertex shaders
+struct FrameData
+{
+    glm::mat4 projection_matrix;    // offset 0
+    glm::vec4 view_matrix[3];       // offset 64, std140 pads each mat3x2 column to a vec4
+    glm::vec2 screen_size;          // offset 112
+    float time;                     // offset 120
+    float padding;                  // block size rounds up to 128
+};
+
+// Per-frame camera data uploaded once into a uniform buffer that all programs read,
+// instead of setting the same matrices on each ShaderProgram.
+class FrameUniforms
+{
+private:
+    GLuint m_buffer;
+    FrameData m_data;
+
+public:
+
+    void load();
+    void cleanup();
+
+    void set_projection_matrix(const glm::mat4 &matrix) { m_data.projection_matrix = matrix; };
+    void set_view_matrix(const Transform2D &matrix);
+    void set_screen_size(float width, float height)     { m_data.screen_size = glm::vec2(width, height); };
+    void set_time(float time)                           { m_data.time = time;                };
+
+    void upload();
+};
@@ -0,0 +1,116 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "GLStateCache.h"
+
+GLStateCache g_glState;
+
+// 0 is a valid binding, so "unknown" needs its own marker
+const GLuint UNKNOWN_BINDING = 0xFFFFFFFF;
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+    for (int i = 0; i < GL_STATE_CALL_COUNT; i++) {
+        m_issued[i] = m_elided[i] = 0;
+        m_last_issued[i] = m_last_elided[i] = 0;
+    }
+}
+
+void GLStateCache::invalidate()
+{
+    m_program = UNKNOWN_BINDING;
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++) m_textures[i] = UNKNOWN_BINDING;
+    m_active_unit = -1;
+    m_blend_enabled = -1;
+    m_blend_src = m_blend_dst = UNKNOWN_BINDING;
+    m_vertex_array = UNKNOWN_BINDING;
+    m_array_buffer = UNKNOWN_BINDING;
+}
+
+void GLStateCache::end_frame()
+{
+    for (int i = 0; i < GL_STATE_CALL_COUNT; i++) {
+        m_last_issued[i] = m_issued[i];
+        m_last_elided[i] = m_elided[i];
+        m_issued[i] = m_elided[i] = 0;
+    }
+}
+
+void GLStateCache::use_program(GLuint program)
+{
+    bool changed = program != m_program;
+    if (changed) glUseProgram(program);
+    m_program = program;
+    record(GL_STATE_PROGRAM, changed);
+}
+
+void GLStateCache::bind_texture(int unit, GLuint texture)
+{
+    bool changed = texture != m_textures[unit];
+    if (changed) {
+        if (unit != m_active_unit) glActiveTexture(GL_TEXTURE0 + unit);
+        m_active_unit = unit;
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+    m_textures[unit] = texture;
+    record(GL_STATE_TEXTURE, changed);
+}
+
+void GLStateCache::delete_texture(GLuint texture)
+{
+    // GL unbinds a deleted texture everywhere, and its name may come back from glGenTextures
+    glDeleteTextures(1, &texture);
+    for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+        if (m_textures[unit] == texture) m_textures[unit] = 0;
+    }
+}
+
+void GLStateCache::set_blend(bool enabled, GLenum src, GLenum dst)
+{
+    int state = enabled ? 1 : 0;
+    bool changed = state != m_blend_enabled;
+    if (changed) {
+        if (enabled) glEnable(GL_BLEND);
+        else glDisable(GL_BLEND);
+    }
+    m_blend_enabled = state;
+    record(GL_STATE_BLEND, changed);
+
+    // the blend function only matters while blending is on
+    if (!enabled) return;
+    changed = src != m_blend_src || dst != m_blend_dst;
+    if (changed) glBlendFunc(src, dst);
+    m_blend_src = src;
+    m_blend_dst = dst;
+    record(GL_STATE_BLEND, changed);
+}
+
+void GLStateCache::bind_vertex_array(GLuint vertex_array)
+{
+    bool changed = vertex_array != m_vertex_array;
+    if (changed) glBindVertexArray(vertex_array);
+    m_vertex_array = vertex_array;
+    record(GL_STATE_VERTEX_ARRAY, changed);
+}
+
+void GLStateCache::bind_array_buffer(GLuint buffer)
+{
+    bool changed = buffer != m_array_buffer;
+    if (changed) glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    m_array_buffer = buffer;
+    record(GL_STATE_BUFFER, changed);
+}
+
+int GLStateCache::get_total_issued() const
+{
+    int total = 0;
+    for (int i = 0; i < GL_STATE_CALL_COUNT; i++) total += m_last_issued[i];
+    return total;
+}
+
+int GLStateCache::get_total_elided() const
+{
+    int total = 0;
+    for (int i = 0; i < GL_STATE_CALL_COUNT; i++) total += m_last_elided[i];
+    return total;
+}
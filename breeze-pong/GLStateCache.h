@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef _WINDOWS
+    #include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+
+// kinds of state change tracked by the cache
+enum GLStateCall
+{
+    GL_STATE_PROGRAM,
+    GL_STATE_TEXTURE,
+    GL_STATE_BLEND,
+    GL_STATE_VERTEX_ARRAY,
+    GL_STATE_BUFFER,
+    GL_STATE_UNIFORM,
+    GL_STATE_CALL_COUNT
+};
+
+// Shadows the GL state we touch so redundant binds never reach the driver.
+// All program, texture, blend, VAO and array buffer changes must go through here
+// once the cache is in use, otherwise its view of the context goes stale.
+class GLStateCache
+{
+private:
+    static const int MAX_TEXTURE_UNITS = 8;
+
+    GLuint m_program;
+    GLuint m_textures[MAX_TEXTURE_UNITS];
+    int m_active_unit;
+    int m_blend_enabled;    // -1 until first set
+    GLenum m_blend_src, m_blend_dst;
+    GLuint m_vertex_array;
+    GLuint m_array_buffer;
+
+    int m_issued[GL_STATE_CALL_COUNT];
+    int m_elided[GL_STATE_CALL_COUNT];
+    int m_last_issued[GL_STATE_CALL_COUNT];
+    int m_last_elided[GL_STATE_CALL_COUNT];
+
+public:
+    GLStateCache();
+
+    void invalidate();
+    void end_frame();
+
+    void use_program(GLuint program);
+    void bind_texture(int unit, GLuint texture);
+    void delete_texture(GLuint texture);
+    void set_blend(bool enabled, GLenum src, GLenum dst);
+    void bind_vertex_array(GLuint vertex_array);
+    void bind_array_buffer(GLuint buffer);
+
+    // lets callers that keep their own shadows (e.g. uniforms) share the counters
+    void record(GLStateCall call, bool issued) { if (issued) m_issued[call]++; else m_elided[call]++; };
+
+    int get_issued(GLStateCall call) const { return m_last_issued[call]; };
+    int get_elided(GLStateCall call) const { return m_last_elided[call]; };
+    int get_total_issued() const;
+    int get_total_elided() const;
+};
+
+extern GLStateCache g_glState;
@@ -0,0 +1,97 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "ImageDecode.h"
+#include "stb_image.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+const int DECODE_CHANNELS = 4;
+
+// stb_image fills its fixed Huffman tables the first time a PNG uses them, which would race
+// between worker threads; every decode goes through here first so that happens exactly once
+void prepare_decoder()
+{
+    static std::once_flag ready;
+    std::call_once(ready, stbi__init_zdefaults);
+}
+
+void report_decode_failure(const char *name)
+{
+    std::cout << "Unable to load image. Provided path '" << name << "' may be incorrect." << std::endl;
+    assert(false);
+}
+
+bool query_image_size(const char *path, int &width, int &height)
+{
+    prepare_decoder();
+    int numOfComponents;
+    if (!stbi_info(path, &width, &height, &numOfComponents)) {
+        report_decode_failure(path);
+        return false;
+    }
+    return true;
+}
+
+bool query_image_size(const char *name, const unsigned char *data, size_t data_size, int &width, int &height)
+{
+    prepare_decoder();
+    int numOfComponents;
+    if (!stbi_info_from_memory(data, (int) data_size, &width, &height, &numOfComponents)) {
+        report_decode_failure(name);
+        return false;
+    }
+    return true;
+}
+
+bool check_decoded(const char *name, unsigned char *pixels)
+{
+    if (pixels == NULL) {
+        report_decode_failure(name);
+        return false;
+    }
+    return true;
+}
+
+bool take_decoded(const char *name, unsigned char *pixels, int width, int height, std::vector<unsigned char> &destination)
+{
+    if (!check_decoded(name, pixels)) return false;
+    destination.assign(pixels, pixels + (size_t) width * height * DECODE_CHANNELS);
+    stbi_image_free(pixels);
+    return true;
+}
+
+bool decode_image_pixels(const char *path, std::vector<unsigned char> &pixels, int &width, int &height)
+{
+    prepare_decoder();
+    int numOfComponents;
+    unsigned char *decoded = stbi_load(path, &width, &height, &numOfComponents, STBI_rgb_alpha);
+    return take_decoded(path, decoded, width, height, pixels);
+}
+
+bool decode_image_pixels(const char *name, const unsigned char *data, size_t data_size, std::vector<unsigned char> &pixels, int &width, int &height)
+{
+    prepare_decoder();
+    int numOfComponents;
+    unsigned char *decoded = stbi_load_from_memory(data, (int) data_size, &width, &height, &numOfComponents, STBI_rgb_alpha);
+    return take_decoded(name, decoded, width, height, pixels);
+}
+
+bool decode_image_copy(const char *path, unsigned char *destination, size_t size)
+{
+    prepare_decoder();
+    int width, height, numOfComponents;
+    unsigned char *pixels = stbi_load(path, &width, &height, &numOfComponents, STBI_rgb_alpha);
+    if (!check_decoded(path, pixels)) return false;
+
+    // the file may have changed since its header was read
+    if ((size_t) width * height * DECODE_CHANNELS != size) {
+        report_decode_failure(path);
+        stbi_image_free(pixels);
+        return false;
+    }
+    memcpy(destination, pixels, size);
+    stbi_image_free(pixels);
+    return true;
+}
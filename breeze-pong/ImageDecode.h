@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// Reads the size of an image from its header without decoding any pixels.
+bool query_image_size(const char *path, int &width, int &height);
+
+// Decodes path as RGBA into pixels, resized to width * height * 4 bytes. The vector is only
+// allocated once stb_image has finished, so its zlib buffers are gone by then. Safe to call
+// from several threads at once.
+bool decode_image_pixels(const char *path, std::vector<unsigned char> &pixels, int &width, int &height);
+
+// Decodes path as RGBA and copies it into destination, which must hold exactly
+// width * height * 4 bytes (see query_image_size). stb_image can only decode into its own
+// heap buffer, since the PNG filters read back rows they have already written, so this is
+// one decode plus one copy; destination may be write-only memory such as a mapped
+// pixel-unpack buffer.
+bool decode_image_copy(const char *path, unsigned char *destination, size_t size);
+
+// The same for an encoded image already in memory (e.g. a blob in the asset pack);
+// name is only used in error messages.
+bool query_image_size(const char *name, const unsigned char *data, size_t data_size, int &width, int &height);
+bool decode_image_pixels(const char *name, const unsigned char *data, size_t data_size, std::vector<unsigned char> &pixels, int &width, int &height);
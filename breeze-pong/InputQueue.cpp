@@ -0,0 +1,48 @@
+#include "InputQueue.h"
+
+InputQueue::InputQueue() : m_watching(false)
+{
+}
+
+void InputQueue::load()
+{
+    SDL_AddEventWatch(watch, this);
+    m_watching = true;
+}
+
+void InputQueue::cleanup()
+{
+    if (m_watching) SDL_DelEventWatch(watch, this);
+    m_watching = false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_events.clear();
+}
+
+int SDLCALL InputQueue::watch(void *queue, SDL_Event *event)
+{
+    // key repeats don't change what's held
+    if ((event->type != SDL_KEYDOWN && event->type != SDL_KEYUP) || event->key.repeat) return 0;
+    InputEvent input;
+    input.time = SDL_GetPerformanceCounter();
+    input.ticks = event->key.timestamp;
+    input.scancode = event->key.keysym.scancode;
+    input.down = event->type == SDL_KEYDOWN;
+    ((InputQueue*) queue)->push(input);
+    return 0;
+}
+
+void InputQueue::push(const InputEvent &event)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_events.push_back(event);
+}
+
+void InputQueue::take(Uint64 until, std::vector<InputEvent> &events)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    while (count < m_events.size() && m_events[count].time < until) count++;
+    events.insert(events.end(), m_events.begin(), m_events.begin() + count);
+    m_events.erase(m_events.begin(), m_events.begin() + count);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <SDL.h>
+#include <mutex>
+#include <vector>
+
+struct InputEvent
+{
+    Uint64 time;            // performance counter when SDL queued the event
+    Uint32 ticks;           // SDL's own timestamp, SDL_GetTicks milliseconds
+    SDL_Scancode scancode;
+    bool down;
+};
+
+// Key presses and releases with high resolution timestamps, for the fixed-step sim to
+// apply at the point inside a tick where they happened. SDL's own event timestamps are
+// whole milliseconds, so an event watch stamps each key event with the performance
+// counter as SDL queues it; events get queued whenever anything pumps (SDL_PollEvent,
+// SDL_PumpEvents, SDL_WaitEventTimeout). Watches can run on whichever thread pushes
+// the event, so the queue is locked.
+class InputQueue
+{
+private:
+    std::mutex m_mutex;
+    std::vector<InputEvent> m_events;   // oldest first
+    bool m_watching;
+
+    static int SDLCALL watch(void *queue, SDL_Event *event);
+
+public:
+    InputQueue();
+
+    void load();
+    void cleanup();
+
+    void push(const InputEvent &event);
+    // moves every event stamped before until into events, oldest first
+    void take(Uint64 until, std::vector<InputEvent> &events);
+};
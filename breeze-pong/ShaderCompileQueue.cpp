@@ -0,0 +1,46 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "ShaderCompileQueue.h"
+
+// hand every core we have to the driver's compiler
+const GLuint MAX_COMPILER_THREADS = 0xFFFFFFFF;
+
+typedef void (APIENTRY *MaxShaderCompilerThreadsFunc)(GLuint count);
+
+void ShaderCompileQueue::load()
+{
+    m_pending.clear();
+
+    const char *entry_point = NULL;
+    if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) entry_point = "glMaxShaderCompilerThreadsKHR";
+    else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile")) entry_point = "glMaxShaderCompilerThreadsARB";
+
+    MaxShaderCompilerThreadsFunc max_threads = NULL;
+    if (entry_point != NULL) max_threads = (MaxShaderCompilerThreadsFunc) SDL_GL_GetProcAddress(entry_point);
+
+    m_parallel = max_threads != NULL;
+    if (m_parallel) max_threads(MAX_COMPILER_THREADS);
+
+    std::cout << "shaders: " << (m_parallel ? "parallel compile" : "no parallel compile extension, compiling in order") << std::endl;
+}
+
+void ShaderCompileQueue::submit(ShaderProgram *program, const char *vertex_shader_file, const char *fragment_shader_file)
+{
+    program->begin_load(vertex_shader_file, fragment_shader_file);
+    m_pending.push_back(program);
+}
+
+bool ShaderCompileQueue::poll()
+{
+    // finish whatever is ready; without the extension every program counts as ready
+    for (size_t i = 0; i < m_pending.size();) {
+        if (!m_parallel || m_pending[i]->is_link_complete()) {
+            m_pending[i]->finish_load();
+            m_pending.erase(m_pending.begin() + i);
+            if (!m_parallel) break;
+        } else {
+            i++;
+        }
+    }
+    return m_pending.empty();
+}
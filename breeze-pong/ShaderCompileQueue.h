@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef _WINDOWS
+    #include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Submits every program's compile and link up front, then lets the caller keep rendering
+// while they finish. With GL_KHR_parallel_shader_compile the driver compiles on its own
+// threads and poll() reports completion per program; without it poll() just finishes the
+// programs one by one, which is exactly the old blocking behaviour.
+class ShaderCompileQueue
+{
+private:
+    std::vector<ShaderProgram*> m_pending;
+    bool m_parallel;
+
+public:
+
+    void load();
+
+    void submit(ShaderProgram *program, const char *vertex_shader_file, const char *fragment_shader_file);
+    bool poll();
+
+    bool const is_parallel() const { return m_parallel; };
+};
@@ -1,37 +1,123 @@
 #define GL_SILENCE_DEPRECATION
 
 #include "ShaderProgram.h"
+#include "FrameUniforms.h"
+#include "AssetPack.h"
+#include <cassert>
+#include <cstring>
+
+// program binaries are cached next to the shaders, one file per vertex/fragment pair
+const char PROGRAM_CACHE_PREFIX[] = "shaders/program_";
+const char PROGRAM_CACHE_SUFFIX[] = ".bin";
+const char PROGRAM_CACHE_MAGIC[4] = { 'B', 'P', 'P', 'B' };
+
+uint64_t hash_string(uint64_t hash, const char *text, size_t length)
+{
+    // FNV-1a, 64-bit
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) text[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hash_string(uint64_t hash, const char *text)
+{
+    return hash_string(hash, text, text ? strlen(text) : 0);
+}
 
 void ShaderProgram::load(const char *vertex_shader_file, const char *fragment_shader_file) {
     
-    // create the vertex shader
-    m_vertex_shader = load_shader_from_file(vertex_shader_file, GL_VERTEX_SHADER);
-    // create the fragment shader
-    m_fragment_shader = load_shader_from_file(fragment_shader_file, GL_FRAGMENT_SHADER);
+    begin_load(vertex_shader_file, fragment_shader_file);
+    finish_load();
+    
+}
+
+void ShaderProgram::begin_load(const char *vertex_shader_file, const char *fragment_shader_file) {
+    
+    m_load_start = std::chrono::steady_clock::now();
+    std::string vertex_source   = read_shader_file(vertex_shader_file);
+    std::string fragment_source = read_shader_file(fragment_shader_file);
+    
+    // a binary is only valid for the exact sources and the exact driver that produced it
+    uint64_t cache_key = 14695981039346656037ull;
+    cache_key = hash_string(cache_key, vertex_source.data(), vertex_source.size());
+    cache_key = hash_string(cache_key, fragment_source.data(), fragment_source.size());
+    cache_key = hash_string(cache_key, (const char *) glGetString(GL_VENDOR));
+    cache_key = hash_string(cache_key, (const char *) glGetString(GL_RENDERER));
+    cache_key = hash_string(cache_key, (const char *) glGetString(GL_VERSION));
+    
+    uint64_t file_key = hash_string(hash_string(14695981039346656037ull, vertex_shader_file), fragment_shader_file);
+    char file_name[17];
+    snprintf(file_name, sizeof(file_name), "%016llx", (unsigned long long) file_key);
+    m_cache_file = std::string(PROGRAM_CACHE_PREFIX) + file_name + PROGRAM_CACHE_SUFFIX;
+    m_cache_key = cache_key;
+    m_source_names = std::string(vertex_shader_file) + " + " + fragment_shader_file;
     
-    // Create the final shader program from our vertex and fragment shaders
+    m_vertex_shader = 0;
+    m_fragment_shader = 0;
     m_program_id = glCreateProgram();
-    glAttachShader(m_program_id, m_vertex_shader);
-    glAttachShader(m_program_id, m_fragment_shader);
-    glLinkProgram(m_program_id);
+    m_from_cache = load_program_binary(m_cache_file, m_cache_key);
     
-    GLint link_success;
-    glGetProgramiv(m_program_id, GL_LINK_STATUS, &link_success);
+    if (!m_from_cache)
+    {
+        // create the vertex shader
+        m_vertex_shader = load_shader_from_string(vertex_source, GL_VERTEX_SHADER);
+        // create the fragment shader
+        m_fragment_shader = load_shader_from_string(fragment_source, GL_FRAGMENT_SHADER);
+        
+        // Create the final shader program from our vertex and fragment shaders
+        glAttachShader(m_program_id, m_vertex_shader);
+        glAttachShader(m_program_id, m_fragment_shader);
+        glProgramParameteri(m_program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(m_program_id);
+    }
     
-    if(link_success == GL_FALSE)
+}
+
+bool ShaderProgram::is_link_complete() const
+{
+    // only meaningful with GL_KHR_parallel_shader_compile; see ShaderCompileQueue
+    GLint complete = GL_TRUE;
+    glGetProgramiv(m_program_id, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void ShaderProgram::finish_load() {
+    
+    if (!m_from_cache)
     {
-        printf("Error linking shader program!\n");
+        // this is where a synchronous driver stalls until the link is done
+        GLint link_success;
+        glGetProgramiv(m_program_id, GL_LINK_STATUS, &link_success);
+        
+        if(link_success == GL_FALSE)
+        {
+            print_shader_errors(m_vertex_shader);
+            print_shader_errors(m_fragment_shader);
+            printf("Error linking shader program!\n");
+        }
+        else
+        {
+            save_program_binary(m_cache_file, m_cache_key);
+        }
     }
     
-    m_model_matrix_uniform      = glGetUniformLocation(m_program_id, "modelMatrix");
-    m_projection_matrix_uniform = glGetUniformLocation(m_program_id, "projectionMatrix");
-    m_view_matrix_uniform       = glGetUniformLocation(m_program_id, "viewMatrix");
-    m_colour_uniform            = glGetUniformLocation(m_program_id, "color");
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_load_start).count();
+    std::cout << "shader: " << m_source_names << " " << (m_from_cache ? "loaded from binary cache" : "compiled")
+              << " in " << load_ms << " ms" << std::endl;
+    
+    reflect_variables();
     
-    m_position_attribute  = glGetAttribLocation(m_program_id, "position");
-    m_tex_coord_attribute = glGetAttribLocation(m_program_id, "texCoord");
+    // point the per-frame block at the shared buffer, if this program reads it
+    GLuint frame_block = glGetUniformBlockIndex(m_program_id, FRAME_UNIFORM_BLOCK);
+    if (frame_block != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(m_program_id, frame_block, FRAME_UNIFORM_BINDING);
+    }
     
-    set_colour(1.0f, 1.0f, 1.0f, 1.0f);
+    set_uniform(COLOUR_UNIFORM, glm::vec4(1.0f));
     
 }
 
@@ -42,8 +128,16 @@ void ShaderProgram::cleanup()
     glDeleteShader(m_fragment_shader);
 }
 
-GLuint ShaderProgram::load_shader_from_file(const std::string &shaderFile, GLenum type)
+std::string ShaderProgram::read_shader_file(const std::string &shaderFile)
 {
+    //Prefer the copy in the mapped asset pack, if there is one and the file hasn't been edited since
+    const unsigned char *packed;
+    size_t packedSize;
+    if (g_assetPack.find(shaderFile.c_str(), packed, packedSize)) {
+        if (g_assetPack.is_current(shaderFile.c_str())) return std::string((const char *) packed, packedSize);
+        std::cout << "Shader file " << shaderFile << " changed since it was packed, reading it from disk" << std::endl;
+    }
+
     //Open a file stream with the file name
     std::ifstream infile(shaderFile);
     
@@ -55,8 +149,63 @@ GLuint ShaderProgram::load_shader_from_file(const std::string &shaderFile, GLenu
     std::stringstream buffer;
     buffer << infile.rdbuf();
     
-    // Load the shader from the contents of the file
-    return load_shader_from_string(buffer.str(), type);
+    return buffer.str();
+}
+
+bool ShaderProgram::load_program_binary(const std::string &cacheFile, uint64_t cacheKey)
+{
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (format_count == 0) return false;
+    
+    std::ifstream infile(cacheFile, std::ios::binary);
+    if (infile.fail()) return false;
+    
+    char magic[4];
+    uint64_t key = 0;
+    uint32_t format = 0, length = 0;
+    infile.read(magic, sizeof(magic));
+    infile.read((char *) &key, sizeof(key));
+    infile.read((char *) &format, sizeof(format));
+    infile.read((char *) &length, sizeof(length));
+    if (!infile || memcmp(magic, PROGRAM_CACHE_MAGIC, sizeof(magic)) != 0 || key != cacheKey) return false;
+    
+    std::vector<char> binary(length);
+    infile.read(binary.data(), length);
+    if (!infile) return false;
+    
+    // the driver may still reject a binary it wrote itself, e.g. after an update
+    glProgramBinary(m_program_id, (GLenum) format, binary.data(), (GLsizei) length);
+    GLint link_success;
+    glGetProgramiv(m_program_id, GL_LINK_STATUS, &link_success);
+    return link_success == GL_TRUE;
+}
+
+void ShaderProgram::save_program_binary(const std::string &cacheFile, uint64_t cacheKey)
+{
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (format_count == 0) return;
+    
+    GLint length = 0;
+    glGetProgramiv(m_program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(m_program_id, length, &length, &format, binary.data());
+    
+    std::ofstream outfile(cacheFile, std::ios::binary | std::ios::trunc);
+    if (outfile.fail()) {
+        std::cout << "Unable to write shader cache:" << cacheFile << std::endl;
+        return;
+    }
+    uint32_t format_field = (uint32_t) format, length_field = (uint32_t) length;
+    outfile.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+    outfile.write((const char *) &cacheKey, sizeof(cacheKey));
+    outfile.write((const char *) &format_field, sizeof(format_field));
+    outfile.write((const char *) &length_field, sizeof(length_field));
+    outfile.write(binary.data(), length);
 }
 
 GLuint ShaderProgram::load_shader_from_string(const std::string &shaderContents, GLenum type)
@@ -68,10 +217,17 @@ GLuint ShaderProgram::load_shader_from_string(const std::string &shaderContents,
     const char *shader_string  = shaderContents.c_str();
     GLint shader_string_length = (GLint) shaderContents.size();
     
-    // Set the shader source to the string and compile shader
+    // Set the shader source to the string and compile shader; the status is only
+    // checked in finish_load() so the compile can run without blocking us
     glShaderSource(shaderID, 1, &shader_string, &shader_string_length);
     glCompileShader(shaderID);
     
+    // return the shader id
+    return shaderID;
+}
+
+void ShaderProgram::print_shader_errors(GLuint shaderID)
+{
     // Check if the shader compiled properly
     GLint compile_success;
     glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compile_success);
@@ -83,31 +239,223 @@ GLuint ShaderProgram::load_shader_from_string(const std::string &shaderContents,
         glGetShaderInfoLog(shaderID, sizeof(messages), 0, &messages[0]);
         std::cout << messages << std::endl;
     }
+}
+
+int uniform_type_size(GLenum type)
+{
+    // every uniform type GLSL 3.30 has; bools and samplers are set as ints
+    switch (type)
+    {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+        case GL_BOOL:
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_1D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_BUFFER:
+        case GL_SAMPLER_2D_RECT:
+        case GL_SAMPLER_2D_RECT_SHADOW:
+        case GL_INT_SAMPLER_1D:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_3D:
+        case GL_INT_SAMPLER_CUBE:
+        case GL_INT_SAMPLER_1D_ARRAY:
+        case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_INT_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D_RECT:
+        case GL_UNSIGNED_INT_SAMPLER_1D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_3D:
+        case GL_UNSIGNED_INT_SAMPLER_CUBE:
+        case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D_RECT:  return 4;
+        case GL_FLOAT_VEC2:
+        case GL_INT_VEC2:
+        case GL_UNSIGNED_INT_VEC2:
+        case GL_BOOL_VEC2:                     return 8;
+        case GL_FLOAT_VEC3:
+        case GL_INT_VEC3:
+        case GL_UNSIGNED_INT_VEC3:
+        case GL_BOOL_VEC3:                     return 12;
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:
+        case GL_UNSIGNED_INT_VEC4:
+        case GL_BOOL_VEC4:
+        case GL_FLOAT_MAT2:                    return 16;
+        case GL_FLOAT_MAT2x3:
+        case GL_FLOAT_MAT3x2:                  return 24;
+        case GL_FLOAT_MAT2x4:
+        case GL_FLOAT_MAT4x2:                  return 32;
+        case GL_FLOAT_MAT3:                    return 36;
+        case GL_FLOAT_MAT3x4:
+        case GL_FLOAT_MAT4x3:                  return 48;
+        case GL_FLOAT_MAT4:                    return 64;
+        default:
+            std::cout << "Unknown uniform type 0x" << std::hex << type << std::dec << std::endl;
+            assert(false);
+            return 0;
+    }
+}
+
+void insert_variable(std::vector<ShaderVariable> &table, const ShaderVariable &variable)
+{
+    size_t mask = table.size() - 1;
+    size_t slot = variable.hash & mask;
+    while (table[slot].type != 0)
+    {
+        if (table[slot].hash == variable.hash)
+        {
+            std::cout << "Shader variable hash collision, one of them will be unreachable" << std::endl;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    table[slot] = variable;
+}
+
+size_t table_size_for(GLint count)
+{
+    // keep the load factor at or under one half so probes stay short
+    size_t size = 1;
+    while (size < (size_t) count * 2) size *= 2;
+    return size;
+}
+
+void ShaderProgram::reflect_variables()
+{
+    // this is the only place uniform and attribute names are handled as strings
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
     
-    // return the shader id
-    return shaderID;
+    ShaderVariable empty = { 0, -1, 0, 0, 0 };
+    m_uniforms.assign(table_size_for(count), empty);
+    m_uniform_shadows.clear();
+    std::vector<GLchar> name(max_length + 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(m_program_id, i, (GLsizei) name.size(), NULL, &size, &type, name.data());
+        
+        // block members have no location of their own
+        GLint location = glGetUniformLocation(m_program_id, name.data());
+        if (location < 0) continue;
+        
+        // arrays are reported as "name[0]"; they are keyed by the bare name
+        std::string key = name.data();
+        size_t bracket = key.find('[');
+        if (bracket != std::string::npos) key.resize(bracket);
+        
+        // linking zeroes every uniform, so zeroed shadows start out accurate
+        ShaderVariable variable = { shader_name_hash(key.c_str()), location, type,
+                                    (int) m_uniform_shadows.size(), uniform_type_size(type) };
+        m_uniform_shadows.resize(m_uniform_shadows.size() + variable.shadow_size, 0);
+        insert_variable(m_uniforms, variable);
+    }
+    
+    glGetProgramiv(m_program_id, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(m_program_id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+    m_attributes.assign(table_size_for(count), empty);
+    name.resize(max_length + 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(m_program_id, i, (GLsizei) name.size(), NULL, &size, &type, name.data());
+        
+        // built-ins like gl_VertexID are active but have no location
+        GLint location = glGetAttribLocation(m_program_id, name.data());
+        if (location < 0) continue;
+        
+        ShaderVariable variable = { shader_name_hash(name.data()), location, type, 0, 0 };
+        insert_variable(m_attributes, variable);
+    }
+}
+
+const ShaderVariable *ShaderProgram::find_variable(const std::vector<ShaderVariable> &table, uint32_t hash) const
+{
+    if (table.empty()) return NULL;
+    size_t mask = table.size() - 1;
+    for (size_t slot = hash & mask; table[slot].type != 0; slot = (slot + 1) & mask)
+    {
+        if (table[slot].hash == hash) return &table[slot];
+    }
+    return NULL;
+}
+
+GLint ShaderProgram::get_attribute(uint32_t name) const
+{
+    const ShaderVariable *variable = find_variable(m_attributes, name);
+    return variable ? variable->location : -1;
+}
+
+const ShaderVariable *ShaderProgram::prepare_uniform(uint32_t name, const void *value, int size)
+{
+    // returns the uniform only if the new value differs from what was last uploaded
+    const ShaderVariable *variable = find_variable(m_uniforms, name);
+    if (variable == NULL) return NULL;
+    assert(variable->shadow_size == size);
+    
+    unsigned char *shadow = &m_uniform_shadows[variable->shadow_offset];
+    bool changed = memcmp(shadow, value, size) != 0;
+    g_glState.record(GL_STATE_UNIFORM, changed);
+    if (!changed) return NULL;
+    
+    memcpy(shadow, value, size);
+    g_glState.use_program(m_program_id);
+    return variable;
+}
+
+void ShaderProgram::set_uniform(uint32_t name, int value)
+{
+    const ShaderVariable *variable = prepare_uniform(name, &value, sizeof(value));
+    if (variable) glUniform1i(variable->location, value);
+}
+
+void ShaderProgram::set_uniform(uint32_t name, float value)
+{
+    const ShaderVariable *variable = prepare_uniform(name, &value, sizeof(value));
+    if (variable) glUniform1f(variable->location, value);
 }
 
-void ShaderProgram::set_colour(float red, float green, float blue, float alpha)
+void ShaderProgram::set_uniform(uint32_t name, const glm::vec2 &value)
 {
-    glUseProgram(m_program_id);
-    glUniform4f(m_colour_uniform, red, green, blue, alpha);
+    const ShaderVariable *variable = prepare_uniform(name, &value, sizeof(value));
+    if (variable) glUniform2fv(variable->location, 1, &value[0]);
 }
 
-void ShaderProgram::set_view_matrix(const glm::mat4 &matrix)
+void ShaderProgram::set_uniform(uint32_t name, const glm::vec4 &value)
 {
-    glUseProgram(m_program_id);
-    glUniformMatrix4fv(m_view_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+    const ShaderVariable *variable = prepare_uniform(name, &value, sizeof(value));
+    if (variable) glUniform4fv(variable->location, 1, &value[0]);
 }
 
-void ShaderProgram::set_model_matrix(const glm::mat4 &matrix)
+void ShaderProgram::set_uniform(uint32_t name, const Transform2D &value)
 {
-    glUseProgram(m_program_id);
-    glUniformMatrix4fv(m_model_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+    const ShaderVariable *variable = prepare_uniform(name, &value, sizeof(value));
+    if (variable) glUniformMatrix3x2fv(variable->location, 1, GL_FALSE, &value[0][0]);
 }
 
-void ShaderProgram::set_projection_matrix(const glm::mat4 &matrix)
+void ShaderProgram::set_uniform(uint32_t name, const glm::mat4 &value)
 {
-    glUseProgram(m_program_id);
-    glUniformMatrix4fv(m_projection_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+    const ShaderVariable *variable = prepare_uniform(name, &value, sizeof(value));
+    if (variable) glUniformMatrix4fv(variable->location, 1, GL_FALSE, &value[0][0]);
 }
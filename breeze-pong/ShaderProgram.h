@@ -9,7 +9,37 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <stdint.h>
+#include <chrono>
+#include <vector>
 #include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "GLStateCache.h"
+#include "Transform2D.h"
+
+// FNV-1a over a uniform or attribute name; constexpr so names used as constants are
+// hashed by the compiler and lookups never touch a string at runtime
+constexpr uint32_t shader_name_hash(const char *name, uint32_t hash = 2166136261u)
+{
+    return *name ? shader_name_hash(name + 1, (hash ^ (uint8_t) *name) * 16777619u) : hash;
+}
+
+// names shared by the game's shaders
+constexpr uint32_t POSITION_ATTRIBUTE   = shader_name_hash("position");
+constexpr uint32_t TEX_COORD_ATTRIBUTE  = shader_name_hash("texCoord");
+constexpr uint32_t MODEL_MATRIX_UNIFORM = shader_name_hash("modelMatrix");
+constexpr uint32_t COLOUR_UNIFORM       = shader_name_hash("color");
+
+// one active uniform or attribute, found by reflection after link
+struct ShaderVariable
+{
+    uint32_t hash;
+    GLint location;
+    GLenum type;        // 0 marks an empty slot
+    int shadow_offset;  // uniforms only: where the last uploaded value lives
+    int shadow_size;
+};
 
 class ShaderProgram
 {
@@ -17,33 +47,57 @@ private:
     void cleanup();
     
     GLuint load_shader_from_string(const std::string &shader_contents, GLenum shader_type);
-    GLuint load_shader_from_file(const std::string &shader_file, GLenum shader_type);
+    std::string read_shader_file(const std::string &shader_file);
+    void print_shader_errors(GLuint shader);
+
+    // on-disk program binaries, see load()
+    bool load_program_binary(const std::string &cache_file, uint64_t cache_key);
+    void save_program_binary(const std::string &cache_file, uint64_t cache_key);
+
+    void reflect_variables();
+    const ShaderVariable *find_variable(const std::vector<ShaderVariable> &table, uint32_t hash) const;
+    const ShaderVariable *prepare_uniform(uint32_t name, const void *value, int size);
 
     GLuint m_program_id;
 
-    GLuint m_projection_matrix_uniform;
-    GLuint m_model_matrix_uniform;
-    GLuint m_view_matrix_uniform;
-    GLuint m_colour_uniform;
+    // open-addressed tables sized to a power of two, keyed by shader_name_hash
+    std::vector<ShaderVariable> m_uniforms;
+    std::vector<ShaderVariable> m_attributes;
 
-    GLuint m_position_attribute;
-    GLuint m_tex_coord_attribute;
+    // last uploaded value of every uniform, so unchanged uniforms are never re-sent
+    std::vector<unsigned char> m_uniform_shadows;
 
     GLuint m_vertex_shader;
     GLuint m_fragment_shader;
+
+    // state carried from begin_load() to finish_load()
+    std::string m_source_names;
+    std::string m_cache_file;
+    uint64_t m_cache_key;
+    bool m_from_cache;
+    std::chrono::steady_clock::time_point m_load_start;
     
 public:
 
     void load(const char *vertex_shader_file, const char *fragment_shader_file);
 
-    void set_model_matrix(const glm::mat4 &matrix);
-    void set_projection_matrix(const glm::mat4 &matrix);
-    void set_view_matrix(const glm::mat4 &matrix);
-    void set_colour(float red, float green, float blue, float alpha);
+    // split form of load() for ShaderCompileQueue: begin_load() submits the compile and
+    // link without waiting, finish_load() blocks until it is done and reads back locations
+    void begin_load(const char *vertex_shader_file, const char *fragment_shader_file);
+    bool is_link_complete() const;
+    void finish_load();
+
+    // typed setters keyed by shader_name_hash; names the program doesn't use are ignored,
+    // like a -1 location. Projection and view come from the shared FrameData block.
+    void set_uniform(uint32_t name, int value);
+    void set_uniform(uint32_t name, float value);
+    void set_uniform(uint32_t name, const glm::vec2 &value);
+    void set_uniform(uint32_t name, const glm::vec4 &value);
+    void set_uniform(uint32_t name, const Transform2D &value);
+    void set_uniform(uint32_t name, const glm::mat4 &value);
+
+    bool has_uniform(uint32_t name) const { return find_variable(m_uniforms, name) != NULL; };
+    GLint get_attribute(uint32_t name) const;
     
     GLuint const get_program_id()               const { return m_program_id;          };
-    GLuint const get_position_attribute()       const { return m_position_attribute;  };
-    GLuint const get_tex_coordinate_attribute() const { return m_tex_coord_attribute; };
-    
-    void set_program_id(GLuint program_id)                         { m_program_id = program_id;                   };
 };
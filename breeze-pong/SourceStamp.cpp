@@ -0,0 +1,44 @@
+#include "SourceStamp.h"
+#include <cstdio>
+#include <sys/stat.h>
+
+uint64_t hash_file_bytes(FILE *file)
+{
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    unsigned char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < read; i++) {
+            hash ^= buffer[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+bool stamp_source(const char *path, SourceStamp &stamp, bool hash)
+{
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+    stamp.size = (uint64_t) info.st_size;
+    stamp.mtime = (int64_t) info.st_mtime;
+    stamp.hash = 0;
+    if (!hash) return true;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+    stamp.hash = hash_file_bytes(file);
+    fclose(file);
+    return true;
+}
+
+bool source_unchanged(const char *path, const SourceStamp &stamp)
+{
+    // an unchanged size and time settle it without reading the file
+    SourceStamp current;
+    if (!stamp_source(path, current, false)) return true;
+    if (current.size != stamp.size) return false;
+    if (current.mtime == stamp.mtime) return true;
+    return stamp_source(path, current, true) && current.hash == stamp.hash;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// What a source file looked like when a baked asset was made from it. The size and
+// modification time are a quick check, the FNV-1a hash of the file's bytes the final word,
+// so a fresh checkout that only touches every file doesn't count as a change.
+struct SourceStamp
+{
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+};
+
+// fills in stamp from the file at path, hashing its contents only when hash is set
+bool stamp_source(const char *path, SourceStamp &stamp, bool hash);
+
+// false once the file at path differs from the one stamped; a missing file can't be checked
+// and counts as unchanged, since shipped builds may leave the sources out
+bool source_unchanged(const char *path, const SourceStamp &stamp);
@@ -0,0 +1,140 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "SpriteBatch.h"
+#include "glm/common.hpp"
+
+// unit quad shared by every instance: x, y, u, v
+const float QUAD_VERTICES[] = {
+    -0.5f, -0.5f, 0.0f, 1.0f,   0.5f, -0.5f, 1.0f, 1.0f,   0.5f,  0.5f, 1.0f, 0.0f,  // triangle 1
+    -0.5f, -0.5f, 0.0f, 1.0f,   0.5f,  0.5f, 1.0f, 0.0f,  -0.5f,  0.5f, 0.0f, 0.0f   // triangle 2
+};
+const GLsizei QUAD_VERTEX_COUNT = 6;
+
+static_assert(sizeof(SpriteInstance) == 32, "SpriteInstance should stay tightly packed");
+
+constexpr uint32_t TRANSFORM_ATTRIBUTE = shader_name_hash("instanceTransform");
+constexpr uint32_t ROTATION_ATTRIBUTE  = shader_name_hash("instanceRotation");
+constexpr uint32_t UV_RECT_ATTRIBUTE   = shader_name_hash("instanceUVRect");
+constexpr uint32_t TINT_ATTRIBUTE      = shader_name_hash("instanceTint");
+
+void SpriteBatch::load(ShaderProgram *shader, int initial_capacity)
+{
+    m_shader = shader;
+    m_texture_id = 0;
+    m_draw_calls = 0;
+    m_sprite_count = 0;
+    m_instances.reserve(initial_capacity);
+
+    m_transform_attribute = m_shader->get_attribute(TRANSFORM_ATTRIBUTE);
+    m_rotation_attribute  = m_shader->get_attribute(ROTATION_ATTRIBUTE);
+    m_uv_rect_attribute   = m_shader->get_attribute(UV_RECT_ATTRIBUTE);
+    m_tint_attribute      = m_shader->get_attribute(TINT_ATTRIBUTE);
+
+    // the quad never changes, so it lives in a static buffer
+    glGenBuffers(1, &m_quad_buffer);
+    g_glState.bind_array_buffer(m_quad_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(QUAD_VERTICES), QUAD_VERTICES, GL_STATIC_DRAW);
+
+    // instance data is rewritten every flush
+    m_instance_buffer_size = (GLsizeiptr) (initial_capacity * sizeof(SpriteInstance));
+    glGenBuffers(1, &m_instance_buffer);
+    g_glState.bind_array_buffer(m_instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, m_instance_buffer_size, NULL, GL_STREAM_DRAW);
+
+    // record the attribute layout once in a VAO instead of re-specifying it every frame
+    glGenVertexArrays(1, &m_vertex_array);
+    g_glState.bind_vertex_array(m_vertex_array);
+
+    // per-vertex attributes come from the static quad
+    g_glState.bind_array_buffer(m_quad_buffer);
+    GLint position_attribute  = m_shader->get_attribute(POSITION_ATTRIBUTE);
+    GLint tex_coord_attribute = m_shader->get_attribute(TEX_COORD_ATTRIBUTE);
+    glVertexAttribPointer(position_attribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*) 0);
+    glEnableVertexAttribArray(position_attribute);
+    glVertexAttribPointer(tex_coord_attribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*) (2 * sizeof(float)));
+    glEnableVertexAttribArray(tex_coord_attribute);
+
+    // per-instance attributes advance once per sprite instead of once per vertex
+    g_glState.bind_array_buffer(m_instance_buffer);
+    glVertexAttribPointer(m_transform_attribute, 4, GL_FLOAT, false, sizeof(SpriteInstance), (void*) offsetof(SpriteInstance, position));
+    glVertexAttribPointer(m_rotation_attribute, 1, GL_FLOAT, false, sizeof(SpriteInstance), (void*) offsetof(SpriteInstance, rotation));
+    glVertexAttribPointer(m_uv_rect_attribute, 4, GL_UNSIGNED_SHORT, true, sizeof(SpriteInstance), (void*) offsetof(SpriteInstance, uv_rect));
+    glVertexAttribPointer(m_tint_attribute, 4, GL_UNSIGNED_BYTE, true, sizeof(SpriteInstance), (void*) offsetof(SpriteInstance, tint));
+    glEnableVertexAttribArray(m_transform_attribute);
+    glEnableVertexAttribArray(m_rotation_attribute);
+    glEnableVertexAttribArray(m_uv_rect_attribute);
+    glEnableVertexAttribArray(m_tint_attribute);
+    glVertexAttribDivisor(m_transform_attribute, 1);
+    glVertexAttribDivisor(m_rotation_attribute, 1);
+    glVertexAttribDivisor(m_uv_rect_attribute, 1);
+    glVertexAttribDivisor(m_tint_attribute, 1);
+
+    g_glState.bind_vertex_array(0);
+}
+
+void SpriteBatch::cleanup()
+{
+    glDeleteVertexArrays(1, &m_vertex_array);
+    glDeleteBuffers(1, &m_quad_buffer);
+    glDeleteBuffers(1, &m_instance_buffer);
+}
+
+void SpriteBatch::begin()
+{
+    m_draw_calls = 0;
+    m_sprite_count = 0;
+    m_texture_id = 0;
+    m_instances.clear();
+
+    g_glState.use_program(m_shader->get_program_id());
+    g_glState.bind_vertex_array(m_vertex_array);
+}
+
+void SpriteBatch::draw(GLuint texture_id, const SpriteInstance &instance)
+{
+    // sprites are drawn in submission order, so a texture change ends the current run
+    if (texture_id != m_texture_id) flush();
+    m_texture_id = texture_id;
+    m_instances.push_back(instance);
+}
+
+void SpriteBatch::draw(GLuint texture_id, const glm::vec2 &position, const glm::vec2 &scale)
+{
+    draw(texture_id, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), position, scale);
+}
+
+void SpriteBatch::draw(GLuint texture_id, const glm::vec4 &uv_rect, const glm::vec2 &position, const glm::vec2 &scale, float rotation)
+{
+    SpriteInstance instance;
+    instance.position = position;
+    instance.scale    = scale;
+    instance.rotation = rotation;
+    instance.uv_rect  = glm::u16vec4(glm::clamp(uv_rect, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    instance.tint     = glm::u8vec4(255);
+    draw(texture_id, instance);
+}
+
+void SpriteBatch::end()
+{
+    flush();
+}
+
+void SpriteBatch::flush()
+{
+    if (m_instances.empty()) return;
+
+    GLsizeiptr bytes = (GLsizeiptr) (m_instances.size() * sizeof(SpriteInstance));
+    if (bytes > m_instance_buffer_size) m_instance_buffer_size = bytes * 2;
+
+    // orphan the old storage so the driver never waits on a draw still reading it
+    g_glState.bind_array_buffer(m_instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, m_instance_buffer_size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_instances.data());
+
+    g_glState.bind_texture(0, m_texture_id);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, QUAD_VERTEX_COUNT, (GLsizei) m_instances.size());
+
+    m_draw_calls++;
+    m_sprite_count += (int) m_instances.size();
+    m_instances.clear();
+}
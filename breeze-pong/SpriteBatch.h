@@ -0,0 +1,63 @@
+#pragma once
+
+#ifdef _WINDOWS
+    #include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include <cstddef>
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "glm/gtc/type_precision.hpp"
+#include "ShaderProgram.h"
+#include "GLStateCache.h"
+
+// per-instance data streamed to the GPU, one entry per sprite; the vertex shader
+// builds the transform from these, so nothing here is a matrix
+struct SpriteInstance
+{
+    glm::vec2 position;
+    glm::vec2 scale;
+    float rotation;         // radians, counter-clockwise
+    glm::u16vec4 uv_rect;   // u, v, width, height in texture space, normalized 16-bit
+    glm::u8vec4 tint;       // normalized 8-bit RGBA
+};
+
+class SpriteBatch
+{
+private:
+    void flush();
+
+    ShaderProgram *m_shader;
+
+    GLuint m_vertex_array;
+    GLuint m_quad_buffer;
+    GLuint m_instance_buffer;
+    GLsizeiptr m_instance_buffer_size;
+
+    GLint m_transform_attribute;
+    GLint m_rotation_attribute;
+    GLint m_uv_rect_attribute;
+    GLint m_tint_attribute;
+
+    GLuint m_texture_id;
+    std::vector<SpriteInstance> m_instances;
+
+    int m_draw_calls;
+    int m_sprite_count;
+
+public:
+
+    void load(ShaderProgram *shader, int initial_capacity);
+    void cleanup();
+
+    void begin();
+    void draw(GLuint texture_id, const SpriteInstance &instance);
+    void draw(GLuint texture_id, const glm::vec2 &position, const glm::vec2 &scale);
+    void draw(GLuint texture_id, const glm::vec4 &uv_rect, const glm::vec2 &position, const glm::vec2 &scale, float rotation = 0.0f);
+    void end();
+
+    int const get_draw_calls()   const { return m_draw_calls;   };
+    int const get_sprite_count() const { return m_sprite_count; };
+};
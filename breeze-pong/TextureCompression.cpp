@@ -0,0 +1,295 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <cstring>
+
+const int BLOCK_SIZE = 4;
+const int BLOCK_PIXELS = BLOCK_SIZE * BLOCK_SIZE;
+const int CHANNELS = 4;
+
+TextureFormat choose_block_format(const unsigned char *rgba, int width, int height)
+{
+    size_t pixels = (size_t) width * height;
+    for (size_t i = 0; i < pixels; i++) {
+        if (rgba[i * CHANNELS + 3] != 255) return TEXTURE_FORMAT_BC3;
+    }
+    return TEXTURE_FORMAT_BC1;
+}
+
+size_t texture_level_size(TextureFormat format, int width, int height)
+{
+    if (format == TEXTURE_FORMAT_RGBA8) return (size_t) width * height * CHANNELS;
+    if (format == TEXTURE_FORMAT_R8) return (size_t) width * height;
+    if (format == TEXTURE_FORMAT_RG8) return (size_t) width * height * 2;
+    size_t blocks = (size_t) ((width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    return blocks * (format == TEXTURE_FORMAT_BC1 ? 8 : 16);
+}
+
+TextureFormat choose_channel_format(const unsigned char *rgba, int width, int height)
+{
+    bool opaque = true;
+    size_t pixels = (size_t) width * height;
+    for (size_t i = 0; i < pixels; i++) {
+        const unsigned char *pixel = rgba + i * CHANNELS;
+        if (pixel[0] != pixel[1] || pixel[1] != pixel[2]) return TEXTURE_FORMAT_RGBA8;
+        if (pixel[3] != 255) opaque = false;
+    }
+    return opaque ? TEXTURE_FORMAT_R8 : TEXTURE_FORMAT_RG8;
+}
+
+void pack_channels(TextureFormat format, const unsigned char *rgba, int width, int height, unsigned char *out)
+{
+    // every write lands at or before the pixel being read, so in place is safe
+    size_t pixels = (size_t) width * height;
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        memmove(out, rgba, pixels * CHANNELS);
+        return;
+    }
+    for (size_t i = 0; i < pixels; i++) {
+        unsigned char grey = rgba[i * CHANNELS], alpha = rgba[i * CHANNELS + 3];
+        if (format == TEXTURE_FORMAT_R8) {
+            out[i] = grey;
+        } else {
+            out[i * 2] = grey;
+            out[i * 2 + 1] = alpha;
+        }
+    }
+}
+
+uint16_t pack_565(const int *colour)
+{
+    return (uint16_t) ((colour[0] * 31 + 127) / 255 << 11 | (colour[1] * 63 + 127) / 255 << 5 | (colour[2] * 31 + 127) / 255);
+}
+
+void unpack_565(uint16_t packed, int *colour)
+{
+    int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    colour[0] = r << 3 | r >> 2;
+    colour[1] = g << 2 | g >> 4;
+    colour[2] = b << 3 | b >> 2;
+}
+
+// the four colours a BC1/BC3 colour block can reference, always in four-colour mode
+void colour_palette(uint16_t c0, uint16_t c1, int palette[4][3])
+{
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+void encode_colour_block(const unsigned char block[BLOCK_PIXELS][CHANNELS], unsigned char *out)
+{
+    // fit the endpoints to the bounding box of the visible pixels, flipping the diagonal
+    // to follow the direction the colours actually vary in, then inset it slightly
+    int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+    int visible = 0;
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        if (block[i][3] == 0) continue;
+        visible++;
+        for (int c = 0; c < 3; c++) {
+            low[c] = std::min(low[c], (int) block[i][c]);
+            high[c] = std::max(high[c], (int) block[i][c]);
+        }
+    }
+    if (visible == 0) {
+        memset(out, 0, 8);
+        return;
+    }
+
+    int centre[3] = { (low[0] + high[0]) / 2, (low[1] + high[1]) / 2, (low[2] + high[2]) / 2 };
+    int covariance_rb = 0, covariance_gb = 0;
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        if (block[i][3] == 0) continue;
+        covariance_rb += (block[i][0] - centre[0]) * (block[i][2] - centre[2]);
+        covariance_gb += (block[i][1] - centre[1]) * (block[i][2] - centre[2]);
+    }
+    if (covariance_rb < 0) std::swap(low[0], high[0]);
+    if (covariance_gb < 0) std::swap(low[1], high[1]);
+    for (int c = 0; c < 3; c++) {
+        int inset = (high[c] - low[c]) / 16;
+        high[c] -= inset;
+        low[c] += inset;
+    }
+
+    uint16_t c0 = pack_565(high), c1 = pack_565(low);
+    if (c0 < c1) std::swap(c0, c1);
+    int palette[4][3];
+    colour_palette(c0, c1, palette);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        for (int i = 0; i < BLOCK_PIXELS; i++) {
+            int best = 0, best_error = 0x7FFFFFFF;
+            for (int p = 0; p < 4; p++) {
+                int error = 0;
+                for (int c = 0; c < 3; c++) error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            indices |= (uint32_t) best << (2 * i);
+        }
+    }
+
+    out[0] = (unsigned char) c0; out[1] = (unsigned char) (c0 >> 8);
+    out[2] = (unsigned char) c1; out[3] = (unsigned char) (c1 >> 8);
+    memcpy(out + 4, &indices, 4);
+}
+
+// the eight alphas a BC3 alpha block can reference when a0 > a1
+void alpha_palette(int a0, int a1, int palette[8])
+{
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (int i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void encode_alpha_block(const unsigned char block[BLOCK_PIXELS][CHANNELS], unsigned char *out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        a0 = std::max(a0, (int) block[i][3]);
+        a1 = std::min(a1, (int) block[i][3]);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int palette[8];
+        alpha_palette(a0, a1, palette);
+        for (int i = 0; i < BLOCK_PIXELS; i++) {
+            int best = 0, best_error = 256;
+            for (int p = 0; p < 8; p++) {
+                int error = std::abs(block[i][3] - palette[p]);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            indices |= (uint64_t) best << (3 * i);
+        }
+    }
+
+    out[0] = (unsigned char) a0;
+    out[1] = (unsigned char) a1;
+    for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char) (indices >> (8 * i));
+}
+
+void compress_level(const unsigned char *rgba, int width, int height, TextureFormat format, unsigned char *out)
+{
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        memcpy(out, rgba, texture_level_size(format, width, height));
+        return;
+    }
+
+    // edge blocks repeat the last row and column
+    unsigned char block[BLOCK_PIXELS][CHANNELS];
+    for (int by = 0; by < height; by += BLOCK_SIZE) {
+        for (int bx = 0; bx < width; bx += BLOCK_SIZE) {
+            for (int i = 0; i < BLOCK_PIXELS; i++) {
+                int x = std::min(bx + i % BLOCK_SIZE, width - 1), y = std::min(by + i / BLOCK_SIZE, height - 1);
+                memcpy(block[i], rgba + ((size_t) y * width + x) * CHANNELS, CHANNELS);
+            }
+            if (format == TEXTURE_FORMAT_BC3) {
+                encode_alpha_block(block, out);
+                out += 8;
+            }
+            encode_colour_block(block, out);
+            out += 8;
+        }
+    }
+}
+
+void build_mip_chain(const unsigned char *rgba, int width, int height, TextureFormat format, int max_levels,
+                     std::vector<unsigned char> &storage, std::vector<TextureLevel> &levels)
+{
+    levels.clear();
+    storage.clear();
+    std::vector<unsigned char> current(rgba, rgba + (size_t) width * height * CHANNELS), next;
+    std::vector<size_t> offsets;
+    while (true) {
+        TextureLevel level = { width, height, NULL, texture_level_size(format, width, height) };
+        offsets.push_back(storage.size());
+        storage.resize(storage.size() + level.size);
+        compress_level(current.data(), width, height, format, &storage[offsets.back()]);
+        levels.push_back(level);
+        if ((width == 1 && height == 1) || (int) levels.size() == max_levels) break;
+
+        // 2x2 box filter, clamped at odd edges
+        int next_width = std::max(width / 2, 1), next_height = std::max(height / 2, 1);
+        next.resize((size_t) next_width * next_height * CHANNELS);
+        for (int y = 0; y < next_height; y++) {
+            for (int x = 0; x < next_width; x++) {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                for (int c = 0; c < CHANNELS; c++) {
+                    int sum = current[((size_t) y0 * width + x0) * CHANNELS + c] + current[((size_t) y0 * width + x1) * CHANNELS + c] +
+                              current[((size_t) y1 * width + x0) * CHANNELS + c] + current[((size_t) y1 * width + x1) * CHANNELS + c];
+                    next[((size_t) y * next_width + x) * CHANNELS + c] = (unsigned char) ((sum + 2) / 4);
+                }
+            }
+        }
+        current.swap(next);
+        width = next_width;
+        height = next_height;
+    }
+    // storage has stopped moving, so the levels can point into it now
+    for (size_t i = 0; i < levels.size(); i++) levels[i].data = &storage[offsets[i]];
+}
+
+void decompress_level(TextureFormat format, const TextureLevel &level, std::vector<unsigned char> &rgba)
+{
+    rgba.resize((size_t) level.width * level.height * CHANNELS);
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        memcpy(rgba.data(), level.data, rgba.size());
+        return;
+    }
+    if (format == TEXTURE_FORMAT_R8 || format == TEXTURE_FORMAT_RG8) {
+        int stride = format == TEXTURE_FORMAT_R8 ? 1 : 2;
+        for (size_t i = 0; i < (size_t) level.width * level.height; i++) {
+            unsigned char grey = level.data[i * stride];
+            rgba[i * CHANNELS] = rgba[i * CHANNELS + 1] = rgba[i * CHANNELS + 2] = grey;
+            rgba[i * CHANNELS + 3] = stride == 2 ? level.data[i * 2 + 1] : 255;
+        }
+        return;
+    }
+
+    const unsigned char *in = level.data;
+    for (int by = 0; by < level.height; by += BLOCK_SIZE) {
+        for (int bx = 0; bx < level.width; bx += BLOCK_SIZE) {
+            int alphas[8];
+            uint64_t alpha_indices = 0;
+            if (format == TEXTURE_FORMAT_BC3) {
+                alpha_palette(in[0], in[1], alphas);
+                for (int i = 0; i < 6; i++) alpha_indices |= (uint64_t) in[2 + i] << (8 * i);
+                in += 8;
+            }
+
+            int palette[4][3];
+            uint16_t c0 = (uint16_t) (in[0] | in[1] << 8), c1 = (uint16_t) (in[2] | in[3] << 8);
+            colour_palette(c0, c1, palette);
+            uint32_t indices;
+            memcpy(&indices, in + 4, 4);
+            in += 8;
+
+            for (int i = 0; i < BLOCK_PIXELS; i++) {
+                int x = bx + i % BLOCK_SIZE, y = by + i / BLOCK_SIZE;
+                if (x >= level.width || y >= level.height) continue;
+                unsigned char *pixel = &rgba[((size_t) y * level.width + x) * CHANNELS];
+                const int *colour = palette[indices >> (2 * i) & 3];
+                pixel[0] = (unsigned char) colour[0];
+                pixel[1] = (unsigned char) colour[1];
+                pixel[2] = (unsigned char) colour[2];
+                pixel[3] = format == TEXTURE_FORMAT_BC3 ? (unsigned char) alphas[alpha_indices >> (3 * i) & 7] : 255;
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// pixel formats a baked texture can be stored in; the values are written to disk
+enum TextureFormat
+{
+    TEXTURE_FORMAT_RGBA8 = 0,
+    TEXTURE_FORMAT_BC1   = 1,   // 4x4 blocks, 8 bytes, opaque RGB
+    TEXTURE_FORMAT_BC3   = 2,   // 4x4 blocks, 16 bytes, RGB plus interpolated alpha
+    TEXTURE_FORMAT_R8    = 3,   // opaque grey, sampled as (r, r, r, 1) through a swizzle
+    TEXTURE_FORMAT_RG8   = 4    // grey plus alpha, sampled as (r, r, r, g)
+};
+
+// one mip level of a texture in its stored format; the bytes live in storage owned elsewhere
+struct TextureLevel
+{
+    int width, height;
+    const unsigned char *data;
+    size_t size;
+};
+
+// BC1 when every pixel is opaque, BC3 otherwise
+TextureFormat choose_block_format(const unsigned char *rgba, int width, int height);
+
+size_t texture_level_size(TextureFormat format, int width, int height);
+
+// R8 when every pixel is an opaque grey, RG8 when they are all grey, RGBA8 otherwise
+TextureFormat choose_channel_format(const unsigned char *rgba, int width, int height);
+
+// Keeps only the channels an uncompressed format stores. Works in place (out == rgba),
+// the result is texture_level_size() bytes long.
+void pack_channels(TextureFormat format, const unsigned char *rgba, int width, int height, unsigned char *out);
+
+// Box-filters the RGBA image down to 1x1, or until max_levels levels (0 for no limit), and
+// stores every level in the given format, back to back in storage. Slow enough that it
+// belongs in the offline baker, not at startup.
+void build_mip_chain(const unsigned char *rgba, int width, int height, TextureFormat format, int max_levels,
+                     std::vector<unsigned char> &storage, std::vector<TextureLevel> &levels);
+
+// Expands a level back to RGBA, for drivers without S3TC support and for measuring error.
+void decompress_level(TextureFormat format, const TextureLevel &level, std::vector<unsigned char> &rgba);
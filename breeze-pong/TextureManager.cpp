@@ -0,0 +1,455 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureManager.h"
+#include "GLStateCache.h"
+#include "AssetPack.h"
+#include <chrono>
+#include <algorithm>
+
+// rows copied per glTexSubImage2D when streaming on the main thread; the budget is checked
+// between stripes, so one stripe is the most a frame can overshoot by
+const int STRIPE_ROWS = 32;
+
+// grey texel drawn in place of anything that isn't resident yet
+const unsigned char PLACEHOLDER_TEXEL[] = { 128, 128, 128, 255 };
+
+uint64_t hash_content(const DecodedImage &image)
+{
+    // FNV-1a over the size and pixels, 64-bit
+    uint64_t hash = 14695981039346656037ull;
+    const int size[2] = { image.width, image.height };
+    const unsigned char *bytes = (const unsigned char *) size;
+    for (size_t i = 0; i < sizeof(size); i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    for (unsigned char pixel : image.pixels) hash = (hash ^ pixel) * 1099511628211ull;
+    return hash;
+}
+
+GLenum client_format(TextureFormat format)
+{
+    return format == TEXTURE_FORMAT_R8 ? GL_RED : format == TEXTURE_FORMAT_RG8 ? GL_RG : GL_RGBA;
+}
+
+TextureDecode decode_texture(const std::string &path)
+{
+    // decoding, hashing and dropping unused channels all happen off the main thread; the copy
+    // in the asset pack is used unless the file on disk has changed since it was packed
+    TextureDecode decode;
+    decode.content_hash = 0;
+    decode.format = TEXTURE_FORMAT_RGBA8;
+    const unsigned char *packed;
+    size_t packed_size;
+    bool decoded = g_assetPack.find(path.c_str(), packed, packed_size) && g_assetPack.is_current(path.c_str()) ?
+                   AtlasPacker::decode_image(path.c_str(), packed, packed_size, decode.image) :
+                   AtlasPacker::decode_image(path.c_str(), decode.image);
+    if (!decoded) return decode;
+
+    DecodedImage &image = decode.image;
+    decode.content_hash = hash_content(image);
+    decode.format = choose_channel_format(image.pixels.data(), image.width, image.height);
+    pack_channels(decode.format, image.pixels.data(), image.width, image.height, image.pixels.data());
+    image.pixels.resize(texture_level_size(decode.format, image.width, image.height));
+    image.pixels.shrink_to_fit();
+    return decode;
+}
+
+TextureManager::TextureManager() : m_uploader(NULL), m_placeholder(0), m_budget(0), m_upload_budget_ms(0.0f), m_resident_bytes(0),
+                                   m_frame(0), m_dedupe_hits(0), m_evictions(0), m_saved_bytes(0)
+{
+}
+
+void TextureManager::load(TextureUploader *uploader, size_t vram_budget, float upload_budget_ms)
+{
+    m_uploader = uploader;
+    m_budget = vram_budget;
+    m_upload_budget_ms = upload_budget_ms;
+
+    glGenTextures(1, &m_placeholder);
+    g_glState.bind_texture(0, m_placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_TEXEL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void TextureManager::cleanup()
+{
+    for (TextureSlot &slot : m_slots) {
+        if (slot.decode.valid()) slot.decode.wait();
+        if (slot.texture != 0 && slot.alias < 0) g_glState.delete_texture(slot.texture);
+    }
+    g_glState.delete_texture(m_placeholder);
+    m_slots.clear();
+    m_free_slots.clear();
+    m_paths.clear();
+    m_resident_bytes = 0;
+}
+
+int TextureManager::allocate_slot()
+{
+    int index;
+    if (!m_free_slots.empty()) {
+        index = m_free_slots.back();
+        m_free_slots.pop_back();
+    } else {
+        index = (int) m_slots.size();
+        m_slots.push_back(TextureSlot());
+        m_slots[index].generation = 0;
+    }
+
+    TextureSlot &slot = m_slots[index];
+    slot.generation++;
+    slot.state = TEXTURE_EMPTY;
+    slot.refs = 1;
+    slot.alias = -1;
+    slot.pinned = false;
+    slot.deferred = false;
+    slot.content_hash = 0;
+    slot.texture = 0;
+    slot.width = 0;
+    slot.height = 0;
+    slot.format = TEXTURE_FORMAT_RGBA8;
+    slot.bytes = 0;
+    slot.last_used = m_frame;
+    slot.upload = -1;
+    slot.rows_uploaded = 0;
+    return index;
+}
+
+void TextureManager::free_slot(int index)
+{
+    TextureSlot &slot = m_slots[index];
+    std::unordered_map<std::string, int>::iterator path = m_paths.find(slot.path);
+    if (path != m_paths.end() && path->second == index) m_paths.erase(path);
+
+    // bumping the generation here as well means stale handles fail even before reuse
+    slot.generation++;
+    slot.state = TEXTURE_EMPTY;
+    slot.path.clear();
+    slot.texture = 0;
+    slot.pending = DecodedImage();
+    m_free_slots.push_back(index);
+}
+
+TextureSlot *TextureManager::resolve(TextureHandle handle)
+{
+    if (handle.generation == 0 || handle.index >= m_slots.size()) return NULL;
+    TextureSlot &slot = m_slots[handle.index];
+    if (slot.generation != handle.generation || slot.state == TEXTURE_EMPTY) return NULL;
+    return &slot;
+}
+
+TextureHandle TextureManager::acquire(const char *path)
+{
+    return open(path, false);
+}
+
+TextureHandle TextureManager::prefetch(const char *path)
+{
+    return open(path, true);
+}
+
+TextureHandle TextureManager::open(const char *path, bool deferred)
+{
+    // the same path always shares one slot; a failed load is tried again, since the file
+    // may have been fixed since (an alias retries the slot that owns its texture)
+    std::unordered_map<std::string, int>::iterator known = m_paths.find(path);
+    if (known != m_paths.end()) {
+        TextureSlot &slot = m_slots[known->second];
+        TextureSlot &owner = slot.alias >= 0 ? m_slots[slot.alias] : slot;
+        if (owner.state == TEXTURE_FAILED) {
+            owner.deferred = owner.deferred && deferred;
+            start_decode(owner, owner.deferred);
+            slot.state = TEXTURE_DECODING;
+        }
+        slot.refs++;
+        TextureHandle handle = { (uint32_t) known->second, slot.generation };
+        return handle;
+    }
+
+    int index = allocate_slot();
+    m_slots[index].path = path;
+    m_slots[index].deferred = deferred;
+    m_paths[path] = index;
+    start_decode(m_slots[index], deferred);
+    TextureHandle handle = { (uint32_t) index, m_slots[index].generation };
+    return handle;
+}
+
+TextureHandle TextureManager::adopt(const char *name, GLuint texture, size_t bytes)
+{
+    int index = allocate_slot();
+    TextureSlot &slot = m_slots[index];
+    slot.path = name;
+    slot.state = TEXTURE_RESIDENT;
+    slot.pinned = true;
+    slot.texture = texture;
+    slot.bytes = bytes;
+    m_resident_bytes += bytes;
+    TextureHandle handle = { (uint32_t) index, slot.generation };
+    return handle;
+}
+
+void TextureManager::release(TextureHandle handle)
+{
+    TextureSlot *slot = resolve(handle);
+    if (slot == NULL || --slot->refs > 0) return;
+
+    // aliases, adopted textures, failures and prefetched pixels nobody drew go at once;
+    // loaded textures stay cached until the budget needs the room
+    int index = (int) handle.index;
+    if (slot->alias >= 0) {
+        TextureSlot &owner = m_slots[slot->alias];
+        TextureHandle owner_handle = { (uint32_t) slot->alias, owner.generation };
+        slot->texture = 0;
+        free_slot(index);
+        release(owner_handle);
+    } else if (slot->pinned || slot->state == TEXTURE_DECODED || slot->state == TEXTURE_FAILED) {
+        unload(*slot);
+        free_slot(index);
+    }
+}
+
+GLuint TextureManager::get(TextureHandle handle)
+{
+    TextureSlot *slot = resolve(handle);
+    if (slot == NULL) return m_placeholder;
+    slot->last_used = m_frame;
+    if (slot->alias >= 0) {
+        slot = &m_slots[slot->alias];
+        slot->last_used = m_frame;
+    }
+
+    if (slot->state == TEXTURE_EVICTED) start_decode(*slot, false);
+
+    // a prefetched texture uploads the first time it is asked for; if its decode hasn't
+    // finished it takes the usual route once it does
+    if (slot->deferred) {
+        slot->deferred = false;
+        if (slot->state == TEXTURE_DECODED) start_upload(*slot, true);
+    }
+    return slot->state == TEXTURE_RESIDENT ? slot->texture : m_placeholder;
+}
+
+TextureState TextureManager::get_state(TextureHandle handle)
+{
+    TextureSlot *slot = resolve(handle);
+    if (slot == NULL) return TEXTURE_EMPTY;
+    return slot->alias >= 0 ? m_slots[slot->alias].state : slot->state;
+}
+
+void TextureManager::start_decode(TextureSlot &slot, bool low_priority)
+{
+    std::string path = slot.path;
+    slot.state = TEXTURE_DECODING;
+    if (!low_priority) {
+        slot.decode = std::async(std::launch::async, decode_texture, path);
+        return;
+    }
+
+    // std::async may hand later tasks the same pooled thread, so the priority goes back afterwards
+    slot.decode = std::async(std::launch::async, [path]() {
+        SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+        TextureDecode decode = decode_texture(path);
+        SDL_SetThreadPriority(SDL_THREAD_PRIORITY_NORMAL);
+        return decode;
+    });
+}
+
+bool TextureManager::same_pixels(const TextureSlot &other, const TextureDecode &decode)
+{
+    // a matching hash is only a hint, the bytes themselves decide; they are still in memory
+    // while streaming, otherwise the texture is read back, which stalls but only happens on
+    // a hash match. Pixels already handed to the upload thread can't be checked
+    const DecodedImage &image = decode.image;
+    if (other.content_hash != decode.content_hash || other.format != decode.format || other.width != image.width || other.height != image.height) return false;
+    if (!other.pending.pixels.empty()) return other.pending.pixels == image.pixels;
+    if (other.state != TEXTURE_RESIDENT) return false;
+
+    std::vector<unsigned char> pixels(image.pixels.size());
+    g_glState.bind_texture(0, other.texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, client_format(other.format), GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return pixels == image.pixels;
+}
+
+void TextureManager::finish_decode(int index)
+{
+    TextureDecode decode = m_slots[index].decode.get();
+    TextureSlot &slot = m_slots[index];
+
+    // released while decoding (e.g. a prefetched banner nobody drew): nothing will ever
+    // release it again, so the result is dropped here instead of cached or aliased
+    if (slot.refs == 0) {
+        free_slot(index);
+        return;
+    }
+    if (decode.image.pixels.empty()) {
+        slot.state = TEXTURE_FAILED;
+        return;
+    }
+    bool first_load = slot.content_hash == 0;
+    slot.content_hash = decode.content_hash;
+    slot.width = decode.image.width;
+    slot.height = decode.image.height;
+
+    // a first load with the same pixels as a live texture borrows that texture instead
+    // (a reload after eviction keeps its own, since aliases may already point at it)
+    for (int i = 0; first_load && i < (int) m_slots.size(); i++) {
+        TextureSlot &other = m_slots[i];
+        bool live = other.state == TEXTURE_RESIDENT || other.state == TEXTURE_UPLOADING;
+        if (i == index || !live || other.alias >= 0 || other.pinned || !same_pixels(other, decode)) continue;
+        slot.alias = i;
+        slot.state = other.state;
+        other.refs++;
+        m_dedupe_hits++;
+        return;
+    }
+
+    size_t rgba_bytes = texture_level_size(TEXTURE_FORMAT_RGBA8, decode.image.width, decode.image.height);
+    slot.format = decode.format;
+    slot.pending = std::move(decode.image);
+    if (first_load) m_saved_bytes += rgba_bytes - slot.pending.pixels.size();
+    if (slot.deferred) {
+        slot.state = TEXTURE_DECODED;
+        return;
+    }
+    start_upload(slot, false);
+}
+
+void TextureManager::start_upload(TextureSlot &slot, bool immediate)
+{
+    DecodedImage &image = slot.pending;
+    slot.bytes = image.pixels.size();
+    m_resident_bytes += slot.bytes;
+    if (!immediate && m_uploader != NULL && m_uploader->is_loaded()) {
+        image.path = slot.path;
+        slot.upload = m_uploader->submit(image, slot.format);
+        slot.pending = DecodedImage();
+        slot.state = TEXTURE_UPLOADING;
+        return;
+    }
+
+    // allocate the storage now and fill it in over the next frames, or all at once when
+    // the texture is wanted this frame
+    glGenTextures(1, &slot.texture);
+    g_glState.bind_texture(0, slot.texture);
+    specify_texture_image(slot.format, image.width, image.height, immediate ? image.pixels.data() : NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    slot.rows_uploaded = 0;
+    slot.state = TEXTURE_UPLOADING;
+    if (immediate) {
+        slot.pending = DecodedImage();
+        slot.state = TEXTURE_RESIDENT;
+    }
+}
+
+void TextureManager::stream_uploads()
+{
+    // always at least one stripe per frame so a tiny budget still makes progress;
+    // textures drawn most recently go first
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool uploaded = false;
+    while (true) {
+        int next = -1;
+        for (int i = 0; i < (int) m_slots.size(); i++) {
+            const TextureSlot &slot = m_slots[i];
+            if (slot.state != TEXTURE_UPLOADING || slot.upload >= 0 || slot.alias >= 0) continue;
+            if (next < 0 || slot.last_used > m_slots[next].last_used) next = i;
+        }
+        if (next < 0) return;
+
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (uploaded && elapsed.count() >= m_upload_budget_ms) return;
+
+        TextureSlot &slot = m_slots[next];
+        int rows = std::min(STRIPE_ROWS, slot.pending.height - slot.rows_uploaded);
+        size_t row_bytes = texture_level_size(slot.format, slot.pending.width, 1);
+        const unsigned char *pixels = &slot.pending.pixels[slot.rows_uploaded * row_bytes];
+        g_glState.bind_texture(0, slot.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, slot.rows_uploaded, slot.pending.width, rows, client_format(slot.format), GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        slot.rows_uploaded += rows;
+        uploaded = true;
+
+        if (slot.rows_uploaded == slot.pending.height) {
+            slot.pending = DecodedImage();
+            slot.state = TEXTURE_RESIDENT;
+        }
+    }
+}
+
+void TextureManager::unload(TextureSlot &slot)
+{
+    if (slot.texture != 0) g_glState.delete_texture(slot.texture);
+    m_resident_bytes -= slot.bytes;
+    slot.texture = 0;
+    slot.bytes = 0;
+}
+
+void TextureManager::update()
+{
+    for (int i = 0; i < (int) m_slots.size(); i++) {
+        TextureSlot &slot = m_slots[i];
+        if (slot.state == TEXTURE_DECODING && slot.decode.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            finish_decode(i);
+        }
+
+        GLuint texture;
+        if (m_slots[i].state == TEXTURE_UPLOADING && m_slots[i].upload >= 0 && m_uploader->poll(m_slots[i].upload, texture)) {
+            // a failed upload never reached the GPU, so its bytes come back off the total
+            m_slots[i].texture = texture;
+            m_slots[i].state = texture != 0 ? TEXTURE_RESIDENT : TEXTURE_FAILED;
+            m_slots[i].upload = -1;
+            if (texture == 0) unload(m_slots[i]);
+        }
+    }
+
+    stream_uploads();
+
+    // aliases follow their owner's state
+    for (TextureSlot &slot : m_slots) {
+        if (slot.alias >= 0 && slot.state != TEXTURE_EMPTY) slot.state = m_slots[slot.alias].state;
+    }
+
+    enforce_budget();
+    m_frame++;
+}
+
+bool TextureManager::has_pending_work() const
+{
+    for (const TextureSlot &slot : m_slots) {
+        if (slot.state == TEXTURE_DECODING || slot.state == TEXTURE_UPLOADING) return true;
+    }
+    return false;
+}
+
+void TextureManager::enforce_budget()
+{
+    // unreferenced textures go first, then anything not drawn this frame, oldest first
+    while (m_resident_bytes > m_budget) {
+        int victim = -1;
+        for (int i = 0; i < (int) m_slots.size(); i++) {
+            const TextureSlot &slot = m_slots[i];
+            if (slot.state != TEXTURE_RESIDENT || slot.alias >= 0 || slot.pinned || slot.last_used == m_frame) continue;
+            if (victim < 0) {
+                victim = i;
+                continue;
+            }
+            const TextureSlot &best = m_slots[victim];
+            bool unreferenced = slot.refs == 0, best_unreferenced = best.refs == 0;
+            if (unreferenced != best_unreferenced ? unreferenced : slot.last_used < best.last_used) victim = i;
+        }
+        if (victim < 0) break;
+
+        TextureSlot &slot = m_slots[victim];
+        unload(slot);
+        m_evictions++;
+        if (slot.refs == 0) {
+            free_slot(victim);
+        } else {
+            slot.state = TEXTURE_EVICTED;
+        }
+    }
+}
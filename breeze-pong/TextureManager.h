@@ -0,0 +1,129 @@
+#pragma once
+
+#ifdef _WINDOWS
+    #include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <future>
+#include <unordered_map>
+#include "AtlasPacker.h"
+#include "TextureUploader.h"
+
+enum TextureState
+{
+    TEXTURE_EMPTY,      // free slot
+    TEXTURE_DECODING,   // on a worker thread
+    TEXTURE_DECODED,    // prefetched, the pixels wait in memory until the first get()
+    TEXTURE_UPLOADING,  // on the upload thread with its fence pending, or streaming in on the main thread
+    TEXTURE_RESIDENT,
+    TEXTURE_EVICTED,    // dropped for the VRAM budget, reloads the next time it is drawn
+    TEXTURE_FAILED
+};
+
+// refers to a slot in the manager; a released slot gets a new generation, so stale
+// handles resolve to nothing instead of to whatever texture reused the slot
+struct TextureHandle
+{
+    uint32_t index;
+    uint32_t generation;    // 0 is never valid
+};
+
+struct TextureDecode
+{
+    DecodedImage image;
+    TextureFormat format;
+    uint64_t content_hash;
+};
+
+struct TextureSlot
+{
+    std::string path;
+    uint32_t generation;
+    TextureState state;
+    int refs;
+    int alias;              // slot that owns the GL texture when the pixels matched an existing one, else -1
+    bool pinned;            // adopted textures have no source to reload from, so they are never evicted
+    bool deferred;          // prefetched and not drawn yet, so the upload waits
+    uint64_t content_hash;
+    GLuint texture;
+    int width, height;
+    TextureFormat format;   // grey images are stored as R8 or RG8
+    size_t bytes;
+    uint64_t last_used;     // frame number
+    int upload;             // TextureUploader job, -1 if none
+    std::future<TextureDecode> decode;
+    DecodedImage pending;   // pixels still to stream in on the main thread
+    int rows_uploaded;
+};
+
+// Owns every GL texture loaded from a file. acquire() returns at once and the load runs
+// in the background (decode on a worker, upload through the TextureUploader when there
+// is one, otherwise a few rows at a time on the main thread within a per-frame time
+// budget); until then get() hands out a placeholder. Identical pixels under different
+// paths share one texture, and grey images take one or two bytes a texel. Textures nobody references stay cached until the resident
+// total exceeds the VRAM budget, then the least recently drawn ones are evicted first.
+class TextureManager
+{
+private:
+    std::vector<TextureSlot> m_slots;
+    std::vector<int> m_free_slots;
+    std::unordered_map<std::string, int> m_paths;
+
+    TextureUploader *m_uploader;
+    GLuint m_placeholder;
+    size_t m_budget;
+    float m_upload_budget_ms;
+    size_t m_resident_bytes;
+    uint64_t m_frame;
+
+    int m_dedupe_hits;
+    int m_evictions;
+    size_t m_saved_bytes;   // versus storing every texture as RGBA8
+
+    int allocate_slot();
+    void free_slot(int index);
+    TextureSlot *resolve(TextureHandle handle);
+    TextureHandle open(const char *path, bool deferred);
+    void start_decode(TextureSlot &slot, bool low_priority);
+    bool same_pixels(const TextureSlot &other, const TextureDecode &decode);
+    void finish_decode(int index);
+    void start_upload(TextureSlot &slot, bool immediate);
+    void stream_uploads();
+    void unload(TextureSlot &slot);
+    void enforce_budget();
+
+public:
+    TextureManager();
+
+    // uploader may be NULL or not loaded, then uploads are streamed in on the calling thread,
+    // spending about upload_budget_ms per update() on them
+    void load(TextureUploader *uploader, size_t vram_budget, float upload_budget_ms);
+    void cleanup();
+
+    TextureHandle acquire(const char *path);
+    // for textures that may never be drawn: decodes at low thread priority and holds the
+    // pixels in memory, uploading them in one go on the first get()
+    TextureHandle prefetch(const char *path);
+    // takes ownership of a texture created elsewhere (e.g. the sprite atlas)
+    TextureHandle adopt(const char *name, GLuint texture, size_t bytes);
+    void release(TextureHandle handle);
+
+    // the texture to draw with this frame; a placeholder while loading or after a failure
+    GLuint get(TextureHandle handle);
+    TextureState get_state(TextureHandle handle);
+
+    // call once per frame: finishes decodes, streams or collects uploads, then evicts down to the budget
+    void update();
+    // true while a decode or upload still needs update() to be called to finish
+    bool has_pending_work() const;
+
+    size_t const get_resident_bytes() const { return m_resident_bytes; };
+    size_t const get_budget()         const { return m_budget;         };
+    int const get_dedupe_hits()       const { return m_dedupe_hits;    };
+    int const get_evictions()         const { return m_evictions;      };
+    size_t const get_saved_bytes()    const { return m_saved_bytes;    };
+};
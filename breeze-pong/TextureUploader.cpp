@@ -0,0 +1,216 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureUploader.h"
+#include "ImageDecode.h"
+#include <cassert>
+#include <cstring>
+
+TextureUploader::TextureUploader() : m_window(NULL), m_context(NULL), m_quit(false), m_next_id(0), m_unpack_buffer(0)
+{
+}
+
+bool TextureUploader::load(SDL_Window *window)
+{
+    // the new context shares textures and sync objects with whichever one is current
+    SDL_GLContext main_context = SDL_GL_GetCurrentContext();
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+
+    // a context can only be current on one thread per window, so the worker gets its own
+    m_window = SDL_CreateWindow("uploader", 0, 0, 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    if (m_window != NULL) m_context = SDL_GL_CreateContext(m_window);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(window, main_context);
+
+    if (m_context == NULL) {
+        std::cout << "uploader: no shared context (" << SDL_GetError() << "), uploading on the main thread" << std::endl;
+        if (m_window != NULL) SDL_DestroyWindow(m_window);
+        m_window = NULL;
+        return false;
+    }
+
+    m_quit = false;
+    m_thread = std::thread(&TextureUploader::run, this);
+    std::cout << "uploader: streaming textures on a shared context" << std::endl;
+    return true;
+}
+
+void TextureUploader::cleanup()
+{
+    if (m_context == NULL) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    // fences that were never polled still need releasing
+    for (auto &entry : m_uploads) {
+        if (entry.second.fence != NULL) glDeleteSync(entry.second.fence);
+    }
+    m_uploads.clear();
+    m_queue.clear();
+
+    SDL_GL_DeleteContext(m_context);
+    SDL_DestroyWindow(m_window);
+    m_context = NULL;
+    m_window = NULL;
+}
+
+int TextureUploader::submit(const char *path)
+{
+    DecodedImage image;
+    image.path = path;
+    image.width = 0;
+    image.height = 0;
+    return submit(image);
+}
+
+int TextureUploader::submit(DecodedImage &image, TextureFormat format)
+{
+    TextureUpload upload;
+    upload.image = std::move(image);
+    upload.format = format;
+    upload.texture = 0;
+    upload.fence = NULL;
+    upload.state = TEXTURE_UPLOAD_QUEUED;
+
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_next_id++;
+        m_uploads.emplace(id, std::move(upload));
+        m_queue.push_back(id);
+    }
+    m_wake.notify_one();
+    return id;
+}
+
+bool TextureUploader::poll(int upload, GLuint &texture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<int, TextureUpload>::iterator found = m_uploads.find(upload);
+    assert(found != m_uploads.end());
+    TextureUpload &job = found->second;
+
+    // a zero timeout only asks whether the GPU got there, it never waits
+    if (job.state == TEXTURE_UPLOAD_IN_FLIGHT) {
+        GLenum status = glClientWaitSync(job.fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glDeleteSync(job.fence);
+            job.fence = NULL;
+            job.state = TEXTURE_UPLOAD_READY;
+        } else if (status == GL_WAIT_FAILED) {
+            glDeleteSync(job.fence);
+            job.fence = NULL;
+            glDeleteTextures(1, &job.texture);
+            job.texture = 0;
+            job.state = TEXTURE_UPLOAD_FAILED;
+        }
+    }
+
+    texture = job.texture;
+    if (job.state != TEXTURE_UPLOAD_READY && job.state != TEXTURE_UPLOAD_FAILED) return false;
+    m_uploads.erase(found);
+    return true;
+}
+
+void TextureUploader::run()
+{
+    SDL_GL_MakeCurrent(m_window, m_context);
+    glGenBuffers(1, &m_unpack_buffer);
+
+    while (true) {
+        TextureUpload job;
+        int id;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+            if (m_quit) break;
+            id = m_queue.front();
+            m_queue.pop_front();
+            TextureUpload &queued = m_uploads.at(id);
+            job.image = std::move(queued.image);
+            job.format = queued.format;
+        }
+
+        upload(job);
+
+        // queued jobs only leave the map through poll(), which waits for a result
+        std::lock_guard<std::mutex> lock(m_mutex);
+        TextureUpload &done = m_uploads.at(id);
+        done.texture = job.texture;
+        done.fence = job.fence;
+        done.state = job.state;
+    }
+
+    glDeleteBuffers(1, &m_unpack_buffer);
+    SDL_GL_MakeCurrent(m_window, NULL);
+}
+
+void TextureUploader::upload(TextureUpload &job)
+{
+    DecodedImage &image = job.image;
+    job.texture = 0;
+    job.fence = NULL;
+    job.state = TEXTURE_UPLOAD_FAILED;
+    bool decode = image.pixels.empty();
+    if (decode && !query_image_size(image.path.c_str(), image.width, image.height)) return;
+
+    // orphan the unpack buffer so this write never waits on the previous upload
+    GLsizeiptr size = (GLsizeiptr) texture_level_size(job.format, image.width, image.height);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_unpack_buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped == NULL) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    // the mapping is write-only, so files are decoded elsewhere and copied in like pixels
+    // that arrive already decoded
+    bool filled = true;
+    if (decode) {
+        filled = decode_image_copy(image.path.c_str(), (unsigned char*) mapped, size);
+    } else {
+        memcpy(mapped, image.pixels.data(), size);
+        image.pixels.clear();
+        image.pixels.shrink_to_fit();
+    }
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) || !filled) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    // with an unpack buffer bound the data pointer is an offset into it, so the driver
+    // can copy into the texture asynchronously
+    glGenTextures(1, &job.texture);
+    glBindTexture(GL_TEXTURE_2D, job.texture);
+    specify_texture_image(job.format, image.width, image.height, (void*) 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // the flush makes the fence visible to the main context
+    job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    job.state = TEXTURE_UPLOAD_IN_FLIGHT;
+}
+
+void specify_texture_image(TextureFormat format, int width, int height, const void *pixels)
+{
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        return;
+    }
+
+    // one- and two-byte rows aren't 4-byte aligned for most widths
+    const GLint GREY[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    const GLint GREY_ALPHA[] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+    bool alpha = format == TEXTURE_FORMAT_RG8;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, alpha ? GL_RG8 : GL_R8, width, height, 0, alpha ? GL_RG : GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, alpha ? GREY_ALPHA : GREY);
+}
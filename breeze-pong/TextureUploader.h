@@ -0,0 +1,82 @@
+#pragma once
+
+#ifdef _WINDOWS
+    #include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "AtlasPacker.h"
+#include "TextureCompression.h"
+
+enum TextureUploadState
+{
+    TEXTURE_UPLOAD_QUEUED,
+    TEXTURE_UPLOAD_IN_FLIGHT,   // GL commands issued on the upload context, fence not yet signalled
+    TEXTURE_UPLOAD_READY,
+    TEXTURE_UPLOAD_FAILED
+};
+
+// one texture on its way to the GPU; path is decoded on the worker if pixels is empty
+struct TextureUpload
+{
+    DecodedImage image;
+    TextureFormat format;   // of image.pixels; files are always decoded as RGBA8
+    GLuint texture;
+    GLsync fence;
+    TextureUploadState state;
+};
+
+// Owns a second GL context that shares objects with the main one and a thread that
+// makes it current. Textures are decoded, copied into a pixel buffer object and
+// uploaded from there on the worker, which then drops a fence; poll() checks that fence
+// without blocking, so the render loop keeps presenting frames while assets arrive.
+// Binds made on the upload context are invisible to g_glState by design.
+class TextureUploader
+{
+private:
+    SDL_Window *m_window;
+    SDL_GLContext m_context;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit;
+
+    // jobs by id until poll() hands their result back; m_queue holds the ids the worker hasn't taken
+    std::unordered_map<int, TextureUpload> m_uploads;
+    std::deque<int> m_queue;
+    int m_next_id;
+
+    // only touched on the worker
+    GLuint m_unpack_buffer;
+
+    void run();
+    void upload(TextureUpload &job);
+
+public:
+    TextureUploader();
+
+    // must be called with the main context current; false means no shared context
+    // could be created and callers should fall back to uploading on the main thread
+    bool load(SDL_Window *window);
+    void cleanup();
+
+    int submit(const char *path);
+    int submit(DecodedImage &image, TextureFormat format = TEXTURE_FORMAT_RGBA8);
+
+    // main thread only; true once the texture can be sampled, with texture set to 0 on failure.
+    // The job is forgotten at that point, so its id must not be polled again
+    bool poll(int upload, GLuint &texture);
+
+    bool const is_loaded() const { return m_context != NULL; };
+};
+
+// glTexImage2D into the bound texture for RGBA8, R8 or RG8 pixels (or a NULL/offset pointer);
+// the narrow formats get swizzles so shaders sample the same RGBA as the source image
+void specify_texture_image(TextureFormat format, int width, int height, const void *pixels);
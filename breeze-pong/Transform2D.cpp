@@ -0,0 +1,42 @@
+#include "Transform2D.h"
+
+Transform2D make_transform_2d(const glm::vec2 &position, const glm::vec2 &scale, float rotation)
+{
+    glm::mat3 matrix = glm::translate(glm::mat3(1.0f), position);
+    matrix = glm::rotate(matrix, rotation);
+    matrix = glm::scale(matrix, scale);
+    return Transform2D(matrix);
+}
+
+Transform2D compose_transform_2d(const Transform2D &parent, const Transform2D &child)
+{
+    Transform2D result;
+    compose_transforms_2d(parent, &child, &result, 1);
+    return result;
+}
+
+glm::vec2 transform_point_2d(const Transform2D &transform, const glm::vec2 &point)
+{
+    return transform[0] * point.x + transform[1] * point.y + transform[2];
+}
+
+void compose_transforms_2d(const Transform2D &parent, const Transform2D *children, Transform2D *out, int count)
+{
+    const float a = parent[0].x, b = parent[0].y;
+    const float c = parent[1].x, d = parent[1].y;
+    const float tx = parent[2].x, ty = parent[2].y;
+
+    const float *in = &children[0][0].x;
+    float *result = &out[0][0].x;
+    for (int i = 0; i < count * 6; i += 6) {
+        float x0 = in[i + 0], y0 = in[i + 1];
+        float x1 = in[i + 2], y1 = in[i + 3];
+        float x2 = in[i + 4], y2 = in[i + 5];
+        result[i + 0] = a * x0 + c * y0;
+        result[i + 1] = b * x0 + d * y0;
+        result[i + 2] = a * x1 + c * y1;
+        result[i + 3] = b * x1 + d * y1;
+        result[i + 4] = a * x2 + c * y2 + tx;
+        result[i + 5] = b * x2 + d * y2 + ty;
+    }
+}
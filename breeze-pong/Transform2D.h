@@ -0,0 +1,19 @@
+#pragma once
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include "glm/mat3x2.hpp"
+#include "glm/mat3x3.hpp"
+#include "glm/vec2.hpp"
+#include "glm/gtx/matrix_transform_2d.hpp"
+
+// 2D affine transform: two basis columns plus a translation column, 24 bytes instead of
+// a 64 byte mat4. The game is strictly 2D, so only the final projection stays a mat4.
+typedef glm::mat3x2 Transform2D;
+
+Transform2D make_transform_2d(const glm::vec2 &position, const glm::vec2 &scale, float rotation);
+Transform2D compose_transform_2d(const Transform2D &parent, const Transform2D &child);
+glm::vec2 transform_point_2d(const Transform2D &transform, const glm::vec2 &point);
+
+// parent * children[i] for a whole array at once; the loop is branch-free over plain
+// floats so the compiler can vectorise it
+void compose_transforms_2d(const Transform2D &parent, const Transform2D *children, Transform2D *out, int count);
@@ -9,7 +9,6 @@
 **/
 
 #define GL_SILENCE_DEPRECATION
-#define STB_IMAGE_IMPLEMENTATION
 
 #ifdef _WINDOWS
 #include <GL/glew.h>
@@ -21,7 +20,25 @@
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "ShaderProgram.h"
-#include "stb_image.h"
+#include "SpriteBatch.h"
+#include "AtlasPacker.h"
+#include "GLStateCache.h"
+#include "FrameUniforms.h"
+#include "Transform2D.h"
+#include "ShaderCompileQueue.h"
+#include "TextureUploader.h"
+#include "TextureManager.h"
+#include "AssetPack.h"
+#include "EmbeddedAssets.h"
+#include "FramePacer.h"
+#include "InputQueue.h"
+#include <vector>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 // window size
 const int WINDOW_WIDTH = 640,
@@ -39,9 +56,13 @@ const int VIEWPORT_X = 0,
 		  VIEWPORT_WIDTH = WINDOW_WIDTH,
 		  VIEWPORT_HEIGHT = WINDOW_HEIGHT;
 
+// the shaders need at least this version of OpenGL, core profile
+const int GL_MAJOR_VERSION_REQUIRED = 3,
+		  GL_MINOR_VERSION_REQUIRED = 3;
+
 // paths for shaders
-const char V_SHADER_PATH[] = "shaders/vertex_textured.glsl",
-		   F_SHADER_PATH[] = "shaders/fragment_textured.glsl";
+const char V_SHADER_PATH[] = "shaders/vertex_instanced.glsl",
+		   F_SHADER_PATH[] = "shaders/fragment_instanced.glsl";
 
 // paths for object sprites
 const char BREEZE_PATH[] = "assets/breeze_thin.png",
@@ -50,6 +71,90 @@ const char BREEZE_PATH[] = "assets/breeze_thin.png",
 		   P2_WINS_PATH[] = "assets/player_2_wins.png",
 		   BACKGROUND_PATH[] = "assets/trial_chamber.png";
 
+// every sprite lives in one atlas; a baked copy (see tools/bake_atlas.cpp) skips PNG decoding
+const char ATLAS_PATH[] = "assets/sprites.atlas";
+
+// the atlas and shaders packed into one mapped file (see tools/pack_assets.cpp); loose files are the fallback
+const char ASSET_PACK_PATH[] = "assets/breeze.pack";
+const char* const SPRITE_PATHS[] = { BREEZE_PATH, WINDBALL_PATH, BACKGROUND_PATH };
+const int NUMBER_OF_SPRITES = sizeof(SPRITE_PATHS) / sizeof(SPRITE_PATHS[0]);
+
+// only one win banner is ever drawn, and only once a match ends, so they stay out of the
+// atlas (the pack keeps them as separate PNGs) and are prefetched after the first frame; the
+// winner's breeze stands in until one is ready
+const char* const WIN_PATHS[] = { P1_WINS_PATH, P2_WINS_PATH };
+const int NUMBER_OF_PLAYERS = sizeof(WIN_PATHS) / sizeof(WIN_PATHS[0]);
+
+// backgrounds tab cycles through; the default one is drawn from the atlas, "--arena <png>" adds more that stream in on demand
+const char* const ARENA_PATHS[] = { BACKGROUND_PATH };
+const int NUMBER_OF_ARENAS = sizeof(ARENA_PATHS) / sizeof(ARENA_PATHS[0]);
+const glm::vec4 FULL_UV = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+// sprite sizes
+const glm::vec2 PLAYER_1_SCALE = glm::vec2(-1.1f, 2.75f),
+				PLAYER_2_SCALE = glm::vec2(1.1f, 2.75f),
+				WINDBALL_SCALE = glm::vec2(0.8f, 0.8f),
+				TEXT_SCALE = glm::vec2(7.0f, 7.0f),
+				WIN_FALLBACK_SCALE = glm::vec2(2.2f, 5.5f),
+				BACKGROUND_SCALE = glm::vec2(10.2f, 7.5f);
+
+// paddle speed in units per second and how far from the centre a paddle can go
+const float PADDLE_SPEED = 3.0f;
+const float PADDLE_LIMIT = 2.5f;
+
+// the sim runs in fixed steps this many times a second whatever the frame rate, capped so a
+// stall's worth of ticks stays cheap to replay; after a stall it replays at most this much
+// time and drops the rest
+const int DEFAULT_TICK_RATE = 240;
+const int MAX_TICK_RATE = 10000;
+const float MAX_TICK_LAG = 0.25f;
+
+// keys that steer the paddles: player 1 up and down, then player 2
+const SDL_Scancode PADDLE_KEYS[] = { SDL_SCANCODE_W, SDL_SCANCODE_S, SDL_SCANCODE_UP, SDL_SCANCODE_DOWN };
+const int NUMBER_OF_PADDLE_KEYS = sizeof(PADDLE_KEYS) / sizeof(PADDLE_KEYS[0]);
+
+// where every match starts; a rematch puts these back without touching any GL resources
+const glm::vec2 PLAYER_1_START = glm::vec2(-4.5f, 0.0f),
+				PLAYER_2_START = glm::vec2(4.5f, 0.0f),
+				WINDBALL_START_DIR = glm::vec2(-0.894f, 0.447f);
+const float WINDBALL_START_SPEED = 3.5f;
+const float GAME_OVER_TIME = 3.0f;
+
+// instances reserved up front by the sprite batch
+const int SPRITE_BATCH_CAPACITY = 64;
+
+// stress benchmark sprite size and how often its stats are printed
+const glm::vec2 STRESS_SCALE = glm::vec2(0.1f, 0.1f);
+const float STRESS_REPORT_INTERVAL = 1.0f;
+
+// the upload benchmark streams this image over and over; frames slower than the factor times the median count as hitches
+const char* const UPLOAD_BENCH_PATH = BACKGROUND_PATH;
+const float HITCH_FACTOR = 2.0f;
+
+// textures loaded from files are evicted, least recently drawn first, above this much VRAM
+const int DEFAULT_VRAM_BUDGET_MB = 64;
+const size_t BYTES_IN_MEGABYTE = 1024 * 1024;
+
+// main-thread texture streaming gets this long per frame when there is no upload thread
+const float DEFAULT_UPLOAD_BUDGET_MS = 2.0f;
+
+// the arena benchmark moves to the next background this often
+const int ARENA_BENCH_SWITCH_FRAMES = 4;
+
+// frame pacing: the pacer sleeps until this long before each deadline, then spins; idle frames
+// block on the event queue for at most the timeout, and reports come out this often
+const float PACER_SPIN_MS = 2.0f;
+const Uint32 IDLE_TIMEOUT_MS = 100;
+const float PACER_REPORT_INTERVAL = 5.0f;
+
+// low latency mode starts frames this long ahead of the expected frame cost; the refresh
+// rate is assumed when the display doesn't report one
+const float LOW_LATENCY_MARGIN_MS = 1.0f;
+const int DEFAULT_REFRESH_HZ = 60;
+
+// input age percentiles are printed this many presented frames apart
+const int INPUT_REPORT_FRAMES = 600;
+
 // const for deltaTime calc
 const float MILLISECONDS_IN_SECOND = 1000.0;
 
@@ -58,119 +163,530 @@ const int NUMBER_OF_TEXTURES = 1; // to be generated, that is
 const GLint LEVEL_OF_DETAIL = 0; // base image level; Level n is the nth mipmap reduction image
 const GLint TEXTURE_BORDER = 0; // this value MUST be zero
 
-// shader and associated matrices
+// shader, sprite batch, per-frame uniforms and associated matrices
+ShaderCompileQueue g_shaderQueue;
 ShaderProgram g_shaderProgram;
-glm::mat4 g_viewMatrix,
-		  g_modelMatrix_p1,
-		  g_modelMatrix_p2,
-	      g_modelMatrix_ball,
-		  g_modelMatrix_text,
-		  g_modelMatrix_back,
-		  g_projectionMatrix;
+SpriteBatch g_spriteBatch;
+FrameUniforms g_frameUniforms;
+Transform2D g_viewMatrix;
+glm::mat4 g_projectionMatrix;
 
 // core globals
 SDL_Window* g_displayWindow;
 bool g_gameIsRunning = true;
 float g_previousTicks;
+Uint64 g_processStart;
+bool g_firstFrameShown = false;
 
 // custom globals
-GLuint g_player1TextureID;
-GLuint g_player2TextureID;
-GLuint g_windballTextureID;
-GLuint g_p1WinsTextureID;
-GLuint g_p2WinsTextureID;
-GLuint g_backgroundTextureID;
-
-glm::vec3 g_player1Pos = glm::vec3(-4.5f, 0.0f, 0.0f);
-glm::vec3 g_player2Pos = glm::vec3(4.5f, 0.0f, 0.0f);
-glm::vec3 g_windballPos = glm::vec3(0.0f);
-
-glm::vec3 g_player1Dir = glm::vec3(0.0f);
-glm::vec3 g_player2Dir = glm::vec3(0.0f);
-glm::vec3 g_windballDir = glm::vec3(-0.894f, 0.447f, 0.0f);
-
-float g_windballSpeed = 3.5f;
-float g_gameOverTimer = 3.0;
+TextureHandle g_atlasTexture = { 0, 0 };
+glm::vec4 g_breezeUV;
+glm::vec4 g_windballUV;
+glm::vec4 g_backgroundUV;
+TextureHandle g_winTextures[NUMBER_OF_PLAYERS] = { { 0, 0 }, { 0, 0 } };
+
+glm::vec2 g_player1Pos = PLAYER_1_START;
+glm::vec2 g_player2Pos = PLAYER_2_START;
+glm::vec2 g_windballPos = glm::vec2(0.0f);
+
+glm::vec2 g_player1Dir = glm::vec2(0.0f);
+glm::vec2 g_player2Dir = glm::vec2(0.0f);
+glm::vec2 g_windballDir = WINDBALL_START_DIR;
+
+float g_windballSpeed = WINDBALL_START_SPEED;
+float g_gameOverTimer = GAME_OVER_TIME;
 float g_AImovementAngle = 0.0f;
 float g_gameOver = 0;
 bool g_vsAI = false;
-
-GLuint load_texture(const char* filepath) {
-	// load image file
-	int width, height, numOfComponents;
-	unsigned char* image = stbi_load(filepath, &width, &height, &numOfComponents, STBI_rgb_alpha);
-	if (image == NULL) {
-		std::cout << "Unable to load image. Provided path '" << filepath << "' may be incorrect." << std::endl;
-		assert(false);
+bool g_paused = false;
+
+// fixed-step sim: key events queued with performance counter timestamps, which paddle keys are
+// held as of g_simTime, and the sim clock itself (0 until the first update)
+InputQueue g_inputQueue;
+std::vector<InputEvent> g_tickEvents;
+bool g_paddleKeyDown[NUMBER_OF_PADDLE_KEYS] = { false, false, false, false };
+int g_tickRate = DEFAULT_TICK_RATE;
+int g_inputPollHz = 0;
+Uint64 g_simTime = 0;
+
+// rematches: "--match-queue" starts the next match by itself when the game over timer runs out,
+// otherwise r does during game over; the clock runs from the reset to the new match's first frame
+bool g_matchQueue = false;
+int g_matchNumber = 1;
+Uint64 g_rematchStart = 0;
+Uint64 g_rematchResetEnd = 0;
+
+// "--fps <n>" caps the frame rate, "--idle" lets paused and finished matches block on input
+FramePacer g_framePacer;
+int g_targetFps = 0;
+bool g_idleMode = false;
+bool g_pacerReport = false;
+bool g_lowLatency = false;
+
+// the input each frame is built from: how far the sim has applied queued input and the SDL
+// timestamp (SDL_GetTicks ms) of the newest paddle key event the sim has applied, which counts
+// once, on the first frame it reaches the screen; "--late-latch" catches the sim up again just
+// before drawing
+bool g_lateLatch = false;
+bool g_inputReport = false;
+Uint32 g_paddleEventTicks = 0;
+bool g_paddleEventPending = false;
+std::vector<float> g_inputSampleAgeMs;
+std::vector<float> g_inputEventAgeMs;
+
+// stress benchmark state: each sprite is position.xy, velocity.xy
+int g_stressSpriteCount = 0;
+std::vector<glm::vec4> g_stressSprites;
+int g_stressFrames = 0;
+float g_stressTimer = 0.0f;
+Uint64 g_stressFrameTicks = 0;
+Uint64 g_stressCpuTicks = 0;
+
+// read every asset from its own file even when a pack is available
+bool g_looseAssets = false;
+
+// whether the driver takes the baked BC1/BC3 atlas as is
+bool g_blockCompression = false;
+
+// background upload state; every texture is owned by the manager
+TextureUploader g_textureUploader;
+TextureManager g_textureManager;
+int g_vramBudgetMB = DEFAULT_VRAM_BUDGET_MB;
+float g_uploadBudgetMs = DEFAULT_UPLOAD_BUDGET_MS;
+
+// arena backgrounds: the one on screen and the next in line, which loads ahead of time
+std::vector<std::string> g_arenaPaths(ARENA_PATHS, ARENA_PATHS + NUMBER_OF_ARENAS);
+int g_arena = 0;
+TextureHandle g_arenaTexture = { 0, 0 };
+TextureHandle g_nextArenaTexture = { 0, 0 };
+
+// arena benchmark state: frames left to time and their timings
+int g_arenaBenchFrames = 0;
+std::vector<float> g_arenaBenchFrameMs;
+Uint64 g_arenaBenchLastFrame = 0;
+bool g_asyncUpload = false;
+std::future<AtlasPacker> g_atlasLoad;
+int g_atlasUpload = -1;
+size_t g_atlasUploadBytes = 0;
+
+// upload benchmark state: uploads still to issue, worker jobs in flight and per-frame timings
+int g_uploadBenchCount = 0;
+int g_uploadBenchRemaining = 0;
+std::vector<int> g_uploadBenchJobs;
+std::vector<GLuint> g_uploadBenchTextures;
+DecodedImage g_uploadBenchImage;
+std::vector<float> g_uploadBenchFrameMs;
+Uint64 g_uploadBenchLastFrame = 0;
+
+AtlasPacker prepare_atlas() {
+	// prefer the atlas in the asset pack, used in place, then the baked atlas, but pack from
+	// the source images if both are missing, out of date or older than a sprite on disk;
+	// "--loose-assets" always packs from the source images
+	AtlasPacker atlas;
+	const unsigned char* packed;
+	size_t packedSize;
+	bool baked = false;
+	if (g_assetPack.find(ATLAS_PATH, packed, packedSize)) baked = atlas.load_baked(packed, packedSize);
+	else if (!g_looseAssets) baked = atlas.load_baked(ATLAS_PATH);
+	for (int i = 0; i < NUMBER_OF_SPRITES && baked; i++) {
+		baked = atlas.contains(SPRITE_PATHS[i]);
+		if (baked && !atlas.is_current(SPRITE_PATHS[i])) {
+			std::cout << "atlas: " << SPRITE_PATHS[i] << " changed since the atlas was baked" << std::endl;
+			baked = false;
+		}
 	}
+	if (baked) return atlas;
+
+	// decode every sprite on its own thread, then pack in a fixed order so the layout is stable
+	std::vector<std::future<DecodedImage>> decodes;
+	for (int i = 0; i < NUMBER_OF_SPRITES; i++) {
+		decodes.push_back(std::async(std::launch::async, [i]() {
+			DecodedImage image;
+			AtlasPacker::decode_image(SPRITE_PATHS[i], image);
+			return image;
+		}));
+	}
+	atlas = AtlasPacker();
+	for (std::future<DecodedImage>& decode : decodes) {
+		DecodedImage image = decode.get();
+		atlas.add_decoded(image);
+	}
+	atlas.pack();
+	return atlas;
+}
+
+void print_atlas_report(const AtlasPacker& atlas) {
+	const char* const FORMAT_NAMES[] = { "RGBA8", "BC1", "BC3" };
+	std::cout << "atlas: " << (atlas.is_baked() ? "baked" : "packed at runtime") << ", " << atlas.get_width() << "x" << atlas.get_height()
+			  << " " << FORMAT_NAMES[atlas.get_format()];
+	std::cout << ", " << atlas.get_region_count() << " regions for " << atlas.get_entry_count() << " sprites, "
+			  << atlas.get_atlas_bytes() / 1024 << " KB of VRAM (" << atlas.get_separate_bytes() / 1024 << " KB as separate textures)" << std::endl;
+}
+
+GLuint load_atlas(AtlasPacker& atlas) {
+	Uint64 uploadStart = SDL_GetPerformanceCounter();
+
+	// without S3TC support a compressed atlas is expanded back to plain RGBA
+	if (!g_blockCompression) atlas.decompress();
+
 	// generate and bind texture ID
 	GLuint textureID;
 	glGenTextures(NUMBER_OF_TEXTURES, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, image);
+	g_glState.bind_texture(0, textureID);
+	if (atlas.get_format() == TEXTURE_FORMAT_RGBA8) {
+		glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, atlas.get_width(), atlas.get_height(), TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, atlas.get_pixels());
+	} else {
+		// the driver takes the blocks exactly as stored
+		GLenum format = atlas.get_format() == TEXTURE_FORMAT_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		const std::vector<TextureLevel>& levels = atlas.get_levels();
+		for (int i = 0; i < (int)levels.size(); i++) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, format, levels[i].width, levels[i].height, TEXTURE_BORDER, (GLsizei)levels[i].size, levels[i].data);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+	}
 
 	// set filter parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-	// release image from memory and return the bound ID
-	stbi_image_free(image);
+	print_atlas_report(atlas);
+	std::cout << "atlas upload: " << (double)(SDL_GetPerformanceCounter() - uploadStart) * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency() << " ms" << std::endl;
 	return textureID;
 }
 
+void set_atlas_uvs(const AtlasPacker& atlas) {
+	g_breezeUV = atlas.get_uv_rect(BREEZE_PATH);
+	g_windballUV = atlas.get_uv_rect(WINDBALL_PATH);
+	g_backgroundUV = atlas.get_uv_rect(BACKGROUND_PATH);
+}
+
+void replace_atlas_texture(GLuint textureID, size_t bytes) {
+	// until the first atlas arrives the handle is invalid and draws as the manager's placeholder
+	g_textureManager.release(g_atlasTexture);
+	g_atlasTexture = g_textureManager.adopt("atlas", textureID, bytes);
+}
+
+void poll_atlas() {
+	// hand the atlas to the uploader as soon as packing finishes
+	if (g_atlasLoad.valid() && g_atlasLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		AtlasPacker atlas = g_atlasLoad.get();
+		set_atlas_uvs(atlas);
+		if (atlas.get_format() != TEXTURE_FORMAT_RGBA8 && g_blockCompression) {
+			// compressed blocks are a quarter of the size and need no conversion, so they go up right here
+			replace_atlas_texture(load_atlas(atlas), atlas.get_atlas_bytes());
+		} else {
+			atlas.decompress();
+			print_atlas_report(atlas);
+			g_atlasUploadBytes = atlas.get_atlas_bytes();
+			DecodedImage image;
+			atlas.release_pixels(image);
+			g_atlasUpload = g_textureUploader.submit(image);
+		}
+	}
+
+	// swap the placeholder out once the upload context's fence has signalled
+	GLuint textureID;
+	if (g_atlasUpload >= 0 && g_textureUploader.poll(g_atlasUpload, textureID)) {
+		if (textureID != 0) replace_atlas_texture(textureID, g_atlasUploadBytes);
+		g_atlasUpload = -1;
+	}
+}
+
+void start_upload_bench() {
+	// the worker decodes and uploads every copy itself; the main thread path decodes once up front
+	// so the frame timings only show what glTexImage2D costs the render loop
+	g_uploadBenchRemaining = g_uploadBenchCount;
+	if (g_asyncUpload) {
+		for (int i = 0; i < g_uploadBenchCount; i++) g_uploadBenchJobs.push_back(g_textureUploader.submit(UPLOAD_BENCH_PATH));
+	} else {
+		AtlasPacker::decode_image(UPLOAD_BENCH_PATH, g_uploadBenchImage);
+	}
+	g_uploadBenchLastFrame = SDL_GetPerformanceCounter();
+}
+
+void print_frame_times(std::vector<float> frameMs) {
+	std::sort(frameMs.begin(), frameMs.end());
+	float median = frameMs[frameMs.size() / 2];
+	int hitches = 0;
+	for (float ms : frameMs) {
+		if (ms > HITCH_FACTOR * median) hitches++;
+	}
+	std::cout << frameMs.size() << " frames, median " << median << " ms, worst " << frameMs.back() << " ms, "
+			  << hitches << " hitches over " << HITCH_FACTOR << "x median";
+}
+
+void report_upload_bench() {
+	std::cout << "upload bench: " << g_uploadBenchCount << " textures of " << UPLOAD_BENCH_PATH
+			  << (g_asyncUpload ? " on the upload thread, " : " on the main thread, ");
+	print_frame_times(g_uploadBenchFrameMs);
+	std::cout << std::endl;
+}
+
+void step_upload_bench() {
+	Uint64 now = SDL_GetPerformanceCounter();
+	g_uploadBenchFrameMs.push_back((float)(now - g_uploadBenchLastFrame) * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency());
+	g_uploadBenchLastFrame = now;
+
+	// one blocking upload per frame on the main thread, or collect whatever the worker has finished
+	if (!g_asyncUpload && g_uploadBenchRemaining > 0) {
+		GLuint textureID;
+		glGenTextures(NUMBER_OF_TEXTURES, &textureID);
+		g_glState.bind_texture(0, textureID);
+		glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, g_uploadBenchImage.width, g_uploadBenchImage.height, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, g_uploadBenchImage.pixels.data());
+		g_uploadBenchTextures.push_back(textureID);
+		g_uploadBenchRemaining--;
+	}
+	for (size_t i = 0; i < g_uploadBenchJobs.size();) {
+		GLuint textureID;
+		if (g_textureUploader.poll(g_uploadBenchJobs[i], textureID)) {
+			g_uploadBenchTextures.push_back(textureID);
+			g_uploadBenchJobs.erase(g_uploadBenchJobs.begin() + i);
+			g_uploadBenchRemaining--;
+		} else {
+			i++;
+		}
+	}
+
+	if (g_uploadBenchRemaining == 0) {
+		report_upload_bench();
+		for (GLuint textureID : g_uploadBenchTextures) g_glState.delete_texture(textureID);
+		g_uploadBenchTextures.clear();
+		g_uploadBenchFrameMs.clear();
+		g_uploadBenchCount = 0;
+	}
+}
+
+bool in_atlas(const std::string& path) {
+	for (int i = 0; i < NUMBER_OF_SPRITES; i++) {
+		if (path == SPRITE_PATHS[i]) return true;
+	}
+	return false;
+}
+
+TextureHandle acquire_arena(int arena) {
+	// the default background is already in the atlas, and render() draws that whenever the
+	// arena's own texture isn't resident, so it never gets a second copy
+	const std::string& path = g_arenaPaths[arena];
+	if (in_atlas(path)) return { 0, 0 };
+	return g_textureManager.acquire(path.c_str());
+}
+
+void select_arena(int arena) {
+	// hold the chosen background and the one after it, so the next switch is usually decoded
+	// already; acquiring before releasing keeps a background both pairs share from reloading
+	int count = (int)g_arenaPaths.size();
+	g_arena = arena % count;
+	TextureHandle current = acquire_arena(g_arena);
+	TextureHandle next = acquire_arena((g_arena + 1) % count);
+	g_textureManager.release(g_arenaTexture);
+	g_textureManager.release(g_nextArenaTexture);
+	g_arenaTexture = current;
+	g_nextArenaTexture = next;
+}
+
+void step_arena_bench() {
+	Uint64 now = SDL_GetPerformanceCounter();
+	if (g_arenaBenchLastFrame != 0) {
+		g_arenaBenchFrameMs.push_back((float)(now - g_arenaBenchLastFrame) * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency());
+	}
+	g_arenaBenchLastFrame = now;
+
+	if (g_arenaBenchFrameMs.size() % ARENA_BENCH_SWITCH_FRAMES == 0) select_arena(g_arena + 1);
+	if ((int)g_arenaBenchFrameMs.size() < g_arenaBenchFrames) return;
+
+	std::cout << "arena bench: " << g_arenaPaths.size() << " arenas, switching every " << ARENA_BENCH_SWITCH_FRAMES << " frames with a "
+			  << g_uploadBudgetMs << " ms upload budget, ";
+	print_frame_times(g_arenaBenchFrameMs);
+	std::cout << ", " << g_textureManager.get_resident_bytes() / BYTES_IN_MEGABYTE << " of " << g_textureManager.get_budget() / BYTES_IN_MEGABYTE
+			  << " MB resident, " << g_textureManager.get_evictions() << " evictions" << std::endl;
+	g_arenaBenchFrameMs.clear();
+	g_arenaBenchFrames = 0;
+}
+
+void prefetch_win_banners() {
+	for (int i = 0; i < NUMBER_OF_PLAYERS; i++) g_winTextures[i] = g_textureManager.prefetch(WIN_PATHS[i]);
+}
+
+void start_next_match() {
+	// only the game state goes back to how it started; the window, context, shaders and textures stay
+	g_rematchStart = SDL_GetPerformanceCounter();
+	g_player1Pos = PLAYER_1_START;
+	g_player2Pos = PLAYER_2_START;
+	g_windballPos = glm::vec2(0.0f);
+	g_windballDir = WINDBALL_START_DIR;
+	g_windballSpeed = WINDBALL_START_SPEED;
+	g_gameOverTimer = GAME_OVER_TIME;
+	g_AImovementAngle = 0.0f;
+	g_gameOver = 0;
+
+	// the winner's banner is still cached, so prefetching both again only decodes the loser's
+	TextureHandle previous[NUMBER_OF_PLAYERS];
+	std::copy(g_winTextures, g_winTextures + NUMBER_OF_PLAYERS, previous);
+	prefetch_win_banners();
+	for (TextureHandle handle : previous) g_textureManager.release(handle);
+
+	g_matchNumber++;
+	g_rematchResetEnd = SDL_GetPerformanceCounter();
+}
+
+void report_rematch() {
+	double frequency = (double)SDL_GetPerformanceFrequency();
+	double resetUs = (double)(g_rematchResetEnd - g_rematchStart) * 1000000.0 / frequency;
+	double nextMatchUs = (double)(SDL_GetPerformanceCounter() - g_rematchStart) * 1000000.0 / frequency;
+	std::cout << "match " << g_matchNumber << ": reset in " << resetUs << " us, first frame after " << nextMatchUs << " us" << std::endl;
+	g_rematchStart = 0;
+}
+
+bool is_quit_event(const SDL_Event& event) {
+	// the hidden upload window keeps SDL from sending SDL_QUIT when this one is closed
+	return event.type == SDL_QUIT || (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE);
+}
+
 void initialize() {
+	// assets compiled into the binary come first, then the mapped pack; "--loose-assets" skips
+	// both so edited shaders and PNGs on disk are picked up during development
+	size_t embeddedSize;
+	const unsigned char* embedded = get_embedded_asset_pack(embeddedSize);
+	if (!g_looseAssets && embedded != NULL && g_assetPack.open_memory(embedded, embeddedSize)) {
+		std::cout << "assets: embedded, " << g_assetPack.get_entry_count() << " entries, " << g_assetPack.get_size() / 1024 << " KB" << std::endl;
+	} else if (!g_looseAssets && g_assetPack.open(ASSET_PACK_PATH)) {
+		std::cout << "assets: mapped " << ASSET_PACK_PATH << ", " << g_assetPack.get_entry_count() << " entries, " << g_assetPack.get_size() / 1024 << " KB" << std::endl;
+	} else {
+		std::cout << "assets: loose files" << std::endl;
+	}
+
+	// all CPU-side texture work runs while SDL and the GL context come up
+	std::future<AtlasPacker> atlasLoad = std::async(std::launch::async, prepare_atlas);
+
 	SDL_Init(SDL_INIT_VIDEO);
+	g_inputQueue.load();
 	g_displayWindow = SDL_CreateWindow("Breeze pong!", 
 									   SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
 									   WINDOW_WIDTH, WINDOW_HEIGHT, 
 									   SDL_WINDOW_OPENGL);
+
+	// the shaders are #version 330; without asking for a 3.3 core context macOS hands out 2.1,
+	// and the upload thread's shared context picks up the same attributes
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, GL_MAJOR_VERSION_REQUIRED);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, GL_MINOR_VERSION_REQUIRED);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+#ifdef __APPLE__
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+#endif
 	SDL_GLContext context = SDL_GL_CreateContext(g_displayWindow);
+	if (context == NULL) {
+		std::cout << "Unable to create an OpenGL " << GL_MAJOR_VERSION_REQUIRED << "." << GL_MINOR_VERSION_REQUIRED << " core context: " << SDL_GetError() << std::endl;
+		assert(false);
+	}
 	SDL_GL_MakeCurrent(g_displayWindow, context);
 
 #ifdef _WINDOWS
+	// core profiles don't list extensions the old way, so GLEW has to be told to load everything
+	glewExperimental = GL_TRUE;
 	glewInit();
 #endif
 
 	glViewport(0, 0, 640, 480);
+	glClearColor(BG_RED, BG_GREEN, BG_BLUE, BG_OPACITY);
+	g_blockCompression = SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") == SDL_TRUE;
+
+	// submit every program now so the driver compiles while we decode textures
+	g_shaderQueue.load();
+	g_shaderQueue.submit(&g_shaderProgram, V_SHADER_PATH, F_SHADER_PATH);
+
+	// with the upload thread running the atlas streams in behind a placeholder,
+	// otherwise upload it and look up each sprite's region here!
+	g_asyncUpload = g_asyncUpload && g_textureUploader.load(g_displayWindow);
+	g_textureManager.load(&g_textureUploader, g_vramBudgetMB * BYTES_IN_MEGABYTE, g_uploadBudgetMs);
+	select_arena(0);
+	if (g_asyncUpload) {
+		g_atlasLoad = std::move(atlasLoad);
+	} else {
+		AtlasPacker atlas = atlasLoad.get();
+		replace_atlas_texture(load_atlas(atlas), atlas.get_atlas_bytes());
+		set_atlas_uvs(atlas);
+	}
+
+	// keep presenting a plain loading screen until every program has linked; quitting meanwhile
+	// skips the rest of the setup and goes straight to shutdown
+	SDL_Event event;
+	while (g_gameIsRunning && !g_shaderQueue.poll()) {
+		while (SDL_PollEvent(&event)) {
+			if (is_quit_event(event)) g_gameIsRunning = false;
+		}
+		glClear(GL_COLOR_BUFFER_BIT);
+		SDL_GL_SwapWindow(g_displayWindow);
+	}
+	if (!g_gameIsRunning) return;
+
+	g_spriteBatch.load(&g_shaderProgram, SPRITE_BATCH_CAPACITY + g_stressSpriteCount);
+
+	// scatter the stress sprites with random velocities; vsync would cap the measurement
+	if (g_stressSpriteCount > 0) {
+		SDL_GL_SetSwapInterval(0);
+		g_stressSprites.resize(g_stressSpriteCount);
+		for (glm::vec4& sprite : g_stressSprites) {
+			sprite.x = ((float)rand() / RAND_MAX - 0.5f) * 10.0f;
+			sprite.y = ((float)rand() / RAND_MAX - 0.5f) * 7.5f;
+			sprite.z = ((float)rand() / RAND_MAX - 0.5f) * 4.0f;
+			sprite.w = ((float)rand() / RAND_MAX - 0.5f) * 4.0f;
+		}
+	}
 
-	g_shaderProgram.load(V_SHADER_PATH, F_SHADER_PATH);
-
-	// load the textures into IDs here!
-	g_player1TextureID = load_texture(BREEZE_PATH);
-	g_player2TextureID = load_texture(BREEZE_PATH);
-	g_windballTextureID = load_texture(WINDBALL_PATH);
-	g_p1WinsTextureID = load_texture(P1_WINS_PATH);
-	g_p2WinsTextureID = load_texture(P2_WINS_PATH);
-	g_backgroundTextureID = load_texture(BACKGROUND_PATH);
-
-	g_viewMatrix = glm::mat4(1.0f);
-	g_modelMatrix_p1 = glm::mat4(1.0f);
-	g_modelMatrix_p2 = glm::mat4(1.0f);
-	g_modelMatrix_ball = glm::mat4(1.0f);
-	g_modelMatrix_text = glm::scale(glm::mat4(1.0f), glm::vec3(7.0f, 7.0f, 0.0f));
-	g_modelMatrix_back = glm::scale(glm::mat4(1.0f), glm::vec3(10.2f, 7.5f, 0.0f));
+	g_viewMatrix = Transform2D(1.0f);
 	g_projectionMatrix = glm::ortho(-5.0f, 5.0f, -3.75f, 3.75f, -1.0f, 1.0f);
 
-	g_shaderProgram.set_projection_matrix(g_projectionMatrix);
-	g_shaderProgram.set_view_matrix(g_viewMatrix);
+	g_frameUniforms.load();
+	g_frameUniforms.set_projection_matrix(g_projectionMatrix);
+	g_frameUniforms.set_view_matrix(g_viewMatrix);
+	g_frameUniforms.set_screen_size(WINDOW_WIDTH, WINDOW_HEIGHT);
 
-	glUseProgram(g_shaderProgram.get_program_id());
+	g_glState.set_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if (g_uploadBenchCount > 0) start_upload_bench();
+}
 
-	glClearColor(BG_RED, BG_GREEN, BG_BLUE, BG_OPACITY);
+int paddle_key_index(SDL_Scancode scancode) {
+	for (int i = 0; i < NUMBER_OF_PADDLE_KEYS; i++) {
+		if (PADDLE_KEYS[i] == scancode) return i;
+	}
+	return -1;
 }
 
-void processInput() {
-	// reset player movement directions
-	g_player1Dir = glm::vec3(0.0f);
-	g_player2Dir = glm::vec3(0.0f);
+void print_percentiles(const char* label, std::vector<float> values) {
+	std::sort(values.begin(), values.end());
+	std::cout << label << " p50 " << values[values.size() / 2] << " ms, p90 " << values[values.size() * 9 / 10]
+			  << " ms, p99 " << values[values.size() * 99 / 100] << " ms, max " << values.back() << " ms";
+}
+
+void report_input_age() {
+	std::cout << "input age at present over " << g_inputSampleAgeMs.size() << " frames" << (g_lateLatch ? " (late latched)" : "") << ": ";
+	print_percentiles("sim input", g_inputSampleAgeMs);
+	if (!g_inputEventAgeMs.empty()) {
+		std::cout << "; " << g_inputEventAgeMs.size() << " paddle key events,";
+		print_percentiles("", g_inputEventAgeMs);
+	}
+	std::cout << std::endl;
+	g_inputSampleAgeMs.clear();
+	g_inputEventAgeMs.clear();
+}
+
+void record_input_age() {
+	// SDL event timestamps are whole SDL_GetTicks milliseconds, the sample time is exact
+	Uint64 now = SDL_GetPerformanceCounter();
+	g_inputSampleAgeMs.push_back((float)(now - g_simTime) * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency());
+	if (g_paddleEventPending) {
+		g_inputEventAgeMs.push_back((float)(SDL_GetTicks() - g_paddleEventTicks));
+		g_paddleEventPending = false;
+	}
+	if ((int)g_inputSampleAgeMs.size() >= INPUT_REPORT_FRAMES) report_input_age();
+}
 
+void processInput() {
 	// check for keystrokes and other events
 	SDL_Event event;
 	while (SDL_PollEvent(&event)) {
-		if (event.type == SDL_QUIT || event.type == SDL_WINDOWEVENT_CLOSE) {
+		if (is_quit_event(event)) {
 			g_gameIsRunning = false;
 		} else if (event.type == SDL_KEYDOWN) {
 			switch (event.key.keysym.sym) {
@@ -180,30 +696,53 @@ void processInput() {
 				case SDLK_t:
 					g_vsAI = !g_vsAI;
 					break;
+				case SDLK_TAB:
+					select_arena(g_arena + 1);
+					break;
+				case SDLK_r:
+					if (g_gameOver) start_next_match();
+					break;
+				case SDLK_p:
+					g_paused = !g_paused;
+					break;
 			}
 		} 
 	}
+}
 
-	// respond to player movement inputs
-	const Uint8* key_state = SDL_GetKeyboardState(NULL);
-	if (key_state[SDL_SCANCODE_W] && g_player1Pos.y <= 2.5f) {
-		g_player1Dir.y += 1.0f;
-	}
-	if (key_state[SDL_SCANCODE_S] && g_player1Pos.y >= -2.5f) {
-		g_player1Dir.y += -1.0f;
-	}
-	if (key_state[SDL_SCANCODE_UP] && g_player2Pos.y <= 2.5f && !g_vsAI) {
-		g_player2Dir.y += 1.0f;
-	}
-	if (key_state[SDL_SCANCODE_DOWN] && g_player2Pos.y >= -2.5f && !g_vsAI) {
-		g_player2Dir.y += -1.0f;
+void move_paddles(Uint64 duration) {
+	// the paddles move for exactly as long as their keys were held within the tick
+	float seconds = (float)duration / SDL_GetPerformanceFrequency();
+	g_player1Dir = glm::vec2(0.0f, (g_paddleKeyDown[0] ? 1.0f : 0.0f) - (g_paddleKeyDown[1] ? 1.0f : 0.0f));
+	g_player2Dir = glm::vec2(0.0f);
+	if (!g_vsAI) g_player2Dir.y = (g_paddleKeyDown[2] ? 1.0f : 0.0f) - (g_paddleKeyDown[3] ? 1.0f : 0.0f);
+	g_player1Pos.y = glm::clamp(g_player1Pos.y + g_player1Dir.y * PADDLE_SPEED * seconds, -PADDLE_LIMIT, PADDLE_LIMIT);
+	if (!g_vsAI) g_player2Pos.y = glm::clamp(g_player2Pos.y + g_player2Dir.y * PADDLE_SPEED * seconds, -PADDLE_LIMIT, PADDLE_LIMIT);
+}
+
+void apply_tick_input(Uint64 tickStart, Uint64 tickEnd) {
+	// split the tick at every key event inside it; anything stamped before the tick (held back
+	// by a pause or a dropped stall) lands at its start
+	g_tickEvents.clear();
+	g_inputQueue.take(tickEnd, g_tickEvents);
+	Uint64 cursor = tickStart;
+	for (const InputEvent& input : g_tickEvents) {
+		Uint64 at = std::max(input.time, tickStart);
+		move_paddles(at - cursor);
+		cursor = at;
+		int key = paddle_key_index(input.scancode);
+		if (key < 0) continue;
+		g_paddleKeyDown[key] = input.down;
+
+		// only now can a frame show the event, so its age is recorded at the next present
+		g_paddleEventTicks = input.ticks;
+		g_paddleEventPending = true;
 	}
+	move_paddles(tickEnd - cursor);
 }
 
-void update() {
-	float ticks = (float)SDL_GetTicks() / MILLISECONDS_IN_SECOND; // get the current number of ticks
-	float deltaTime = ticks - g_previousTicks; // the delta time is the difference from the last frame
-	g_previousTicks = ticks;
+void tick(Uint64 tickStart, Uint64 tickEnd) {
+	float deltaTime = (float)(tickEnd - tickStart) / SDL_GetPerformanceFrequency();
 
 	// if player 2 is AI-controlled, they move in a sinusoidal pattern
 	if (g_vsAI) {
@@ -216,10 +755,10 @@ void update() {
 	float yDistFrom2 = g_windballPos.y - g_player2Pos.y;
 	if (g_windballPos.x < -3.7f && g_windballPos.x > -4.3f && abs(yDistFrom1) < 1.5f) {
 		g_windballDir.x = 1.0f;
-		g_windballDir = glm::normalize(g_windballDir + glm::vec3(0.0f, 0.4*yDistFrom1, 0.0f));
+		g_windballDir = glm::normalize(g_windballDir + glm::vec2(0.0f, 0.4f*yDistFrom1));
 	} else if (g_windballPos.x > 3.7f && g_windballPos.x < (g_vsAI? 4.8f : 4.3f) && abs(yDistFrom2) < 1.5f) {
 		g_windballDir.x = -1.0f;
-		g_windballDir = glm::normalize(g_windballDir + glm::vec3(0.0f, 0.4*yDistFrom2, 0.0f));
+		g_windballDir = glm::normalize(g_windballDir + glm::vec2(0.0f, 0.4f*yDistFrom2));
 	}
 	if (g_windballPos.y > 3.5f || g_windballPos.y < -3.5f) {
 		g_windballDir.y = -g_windballDir.y;
@@ -230,79 +769,248 @@ void update() {
 	if (g_windballPos.x > 5.0f) g_gameOver = 1;
 	else if (g_windballPos.x < -5.0f) g_gameOver = 2;
 	if (g_gameOver) g_gameOverTimer -= 1.0f * deltaTime;
-	if (g_gameOverTimer <= 0.0f) g_gameIsRunning = false;
+	if (g_gameOverTimer <= 0.0f) {
+		if (g_matchQueue) start_next_match();
+		else g_gameIsRunning = false;
+	}
 
 	// apply motion
-	g_player1Pos += g_player1Dir * 3.0f * deltaTime;
-	if (!g_vsAI) g_player2Pos += g_player2Dir * 3.0f * deltaTime;
+	apply_tick_input(tickStart, tickEnd);
 	g_windballPos += g_windballDir * g_windballSpeed * deltaTime;
 	g_windballSpeed += 0.08f * deltaTime;
+}
 
-	// reset and translate all the objects
-	g_modelMatrix_p1 = glm::mat4(1.0f);
-	g_modelMatrix_p2 = glm::mat4(1.0f);
-	g_modelMatrix_ball = glm::mat4(1.0f);
-	g_modelMatrix_p1 = glm::translate(g_modelMatrix_p1, g_player1Pos);
-	g_modelMatrix_p2 = glm::translate(g_modelMatrix_p2, g_player2Pos);
-	g_modelMatrix_ball = glm::translate(g_modelMatrix_ball, g_windballPos);
-
-	// scale everything to the correct shape
-	g_modelMatrix_p1 = glm::scale(g_modelMatrix_p1, glm::vec3(-1.1f, 2.75f, 0.0f));
-	g_modelMatrix_p2 = glm::scale(g_modelMatrix_p2, glm::vec3(1.1f, 2.75f, 0.0f));
-	g_modelMatrix_ball = glm::scale(g_modelMatrix_ball, glm::vec3(0.8f, 0.8f, 0.0f));
+void run_ticks(Uint64 now) {
+	// the sim clock is the performance counter; a pause stops it, still tracking which keys
+	// are held, and a long stall only replays the last MAX_TICK_LAG seconds
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	Uint64 step = std::max(frequency / g_tickRate, (Uint64)1);
+	Uint64 maxLag = (Uint64)(MAX_TICK_LAG * frequency);
+	if (g_simTime == 0 || g_paused) {
+		if (g_paused) apply_tick_input(now, now);
+		g_simTime = now;
+		return;
+	}
+	if (now - g_simTime > maxLag) g_simTime = now - maxLag;
+	while (g_simTime + step <= now && g_gameIsRunning) {
+		tick(g_simTime, g_simTime + step);
+		g_simTime += step;
+	}
 }
 
-void draw_object(glm::mat4& modelMatrix, GLuint& textureID) {
-	g_shaderProgram.set_model_matrix(modelMatrix);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
+void late_latch() {
+	// pull in whatever arrived since processInput, leaving it queued for the next one, and run
+	// any ticks that have come due since update
+	SDL_PumpEvents();
+	run_ticks(SDL_GetPerformanceCounter());
 }
 
-void render() {
-	glClear(GL_COLOR_BUFFER_BIT);
+void update() {
+	float ticks = (float)SDL_GetTicks() / MILLISECONDS_IN_SECOND; // get the current number of ticks
+	float deltaTime = ticks - g_previousTicks; // the delta time is the difference from the last frame
+	g_previousTicks = ticks;
+	run_ticks(SDL_GetPerformanceCounter());
+	if (g_paused) return;
+
+	// the stress sprites are scenery, so they move once a frame outside the fixed step
+	for (glm::vec4& sprite : g_stressSprites) {
+		sprite.x += sprite.z * deltaTime;
+		sprite.y += sprite.w * deltaTime;
+		if (sprite.x > 5.0f || sprite.x < -5.0f) sprite.z = -sprite.z;
+		if (sprite.y > 3.75f || sprite.y < -3.75f) sprite.w = -sprite.w;
+	}
+	if (g_stressSpriteCount > 0) g_stressTimer += deltaTime;
+}
 
-	// vertices for square sprite
-	float vertices[] = {
-		-0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,  // triangle 1
-		-0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f   // triangle 2
-	};
+void report_stress_stats() {
+	double frameMs = (double)g_stressFrameTicks * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency() / g_stressFrames;
+	double cpuMs = (double)g_stressCpuTicks * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency() / g_stressFrames;
+	std::cout << "stress: " << g_spriteBatch.get_sprite_count() << " sprites, "
+			  << g_spriteBatch.get_draw_calls() << " draw calls, "
+			  << g_glState.get_total_issued() << " GL state calls issued / " << g_glState.get_total_elided() << " elided, "
+			  << cpuMs << " ms cpu, " << frameMs << " ms/frame (" << g_stressFrames / g_stressTimer << " fps)" << std::endl;
+	g_stressFrames = 0;
+	g_stressTimer = 0.0f;
+	g_stressFrameTicks = 0;
+	g_stressCpuTicks = 0;
+}
 
-	// vertices for texture coords
-	float texture_coordinates[] = {
-		0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,     // triangle 1
-		0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,     // triangle 2
-	};
+void draw_win_banner(GLuint atlasTextureID) {
+	// the loser's banner is never drawn, so its pixels can go
+	int winner = (int)g_gameOver - 1;
+	g_textureManager.release(g_winTextures[1 - winner]);
+	g_winTextures[1 - winner] = { 0, 0 };
+
+	GLuint bannerTextureID = g_textureManager.get(g_winTextures[winner]);
+	if (g_textureManager.get_state(g_winTextures[winner]) == TEXTURE_RESIDENT) {
+		g_spriteBatch.draw(bannerTextureID, FULL_UV, glm::vec2(0.0f), TEXT_SCALE);
+	} else {
+		glm::vec2 scale = winner == 0 ? WIN_FALLBACK_SCALE * glm::vec2(-1.0f, 1.0f) : WIN_FALLBACK_SCALE;
+		g_spriteBatch.draw(atlasTextureID, g_breezeUV, glm::vec2(0.0f), scale);
+	}
+}
 
-	glVertexAttribPointer(g_shaderProgram.get_position_attribute(), 2, GL_FLOAT, false, 0, vertices);
-	glEnableVertexAttribArray(g_shaderProgram.get_position_attribute());
+void render() {
+	Uint64 frameStart = SDL_GetPerformanceCounter();
+	if (g_asyncUpload) poll_atlas();
+	if (g_uploadBenchCount > 0) step_upload_bench();
+	if (g_arenaBenchFrames > 0) step_arena_bench();
+	// texture loads only advance here, once per frame; it issues GL calls and decides what
+	// to evict from what was drawn, so it sits with the drawing rather than in update()
+	g_textureManager.update();
+	GLuint atlasTextureID = g_textureManager.get(g_atlasTexture);
+
+	// the default background comes from the atlas, which also shows while another arena streams in
+	GLuint arenaTextureID = g_textureManager.get(g_arenaTexture);
+	glm::vec4 arenaUV = FULL_UV;
+	if (g_textureManager.get_state(g_arenaTexture) != TEXTURE_RESIDENT) {
+		arenaTextureID = atlasTextureID;
+		arenaUV = g_backgroundUV;
+	}
+	glClear(GL_COLOR_BUFFER_BIT);
 
-	glVertexAttribPointer(g_shaderProgram.get_tex_coordinate_attribute(), 2, GL_FLOAT, false, 0, texture_coordinates);
-	glEnableVertexAttribArray(g_shaderProgram.get_tex_coordinate_attribute());
+	// one upload of the camera data serves every program this frame
+	g_frameUniforms.set_time(g_previousTicks);
+	g_frameUniforms.upload();
 
 	// draw the sprites here!
-	draw_object(g_modelMatrix_back, g_backgroundTextureID);
-	draw_object(g_modelMatrix_p1, g_player1TextureID);
-	draw_object(g_modelMatrix_p2, g_player2TextureID);
-	if (!g_gameOver) draw_object(g_modelMatrix_ball, g_windballTextureID);
-	if (g_gameOver) draw_object(g_modelMatrix_text, (g_gameOver == 1) ? g_p1WinsTextureID : g_p2WinsTextureID);
+	if (g_lateLatch) late_latch();
+	g_spriteBatch.begin();
+	g_spriteBatch.draw(arenaTextureID, arenaUV, glm::vec2(0.0f), BACKGROUND_SCALE);
+	for (const glm::vec4& sprite : g_stressSprites) {
+		g_spriteBatch.draw(atlasTextureID, g_windballUV, glm::vec2(sprite), STRESS_SCALE, sprite.z * g_previousTicks);
+	}
+	g_spriteBatch.draw(atlasTextureID, g_breezeUV, g_player1Pos, PLAYER_1_SCALE);
+	g_spriteBatch.draw(atlasTextureID, g_breezeUV, g_player2Pos, PLAYER_2_SCALE);
+	if (!g_gameOver) g_spriteBatch.draw(atlasTextureID, g_windballUV, g_windballPos, WINDBALL_SCALE);
+	if (g_gameOver) draw_win_banner(atlasTextureID);
+	g_spriteBatch.end();
+	Uint64 submitEnd = SDL_GetPerformanceCounter();
+
+	// in low latency mode nothing queues up in the driver: the GPU finishes before the swap
+	// and the swap itself is waited out, so its completion times track the display's vblanks
+	if (g_framePacer.is_low_latency()) {
+		glFinish();
+		g_framePacer.mark_ready();
+	}
+	SDL_GL_SwapWindow(g_displayWindow);
+	if (g_framePacer.is_low_latency()) {
+		glFinish();
+		g_framePacer.mark_presented();
+	}
+	g_glState.end_frame();
+	if (g_inputReport) record_input_age();
+
+	if (!g_firstFrameShown) {
+		g_firstFrameShown = true;
+		double firstFrameMs = (double)(SDL_GetPerformanceCounter() - g_processStart) * MILLISECONDS_IN_SECOND / SDL_GetPerformanceFrequency();
+		std::cout << "time to first frame: " << firstFrameMs << " ms" << std::endl;
+		prefetch_win_banners();
+	}
+	if (g_rematchStart != 0) report_rematch();
+
+	// stress benchmark bookkeeping
+	if (g_stressSpriteCount > 0) {
+		g_stressFrameTicks += SDL_GetPerformanceCounter() - frameStart;
+		g_stressCpuTicks += submitEnd - frameStart;
+		g_stressFrames++;
+		if (g_stressTimer >= STRESS_REPORT_INTERVAL) report_stress_stats();
+	}
+}
 
-	glDisableVertexAttribArray(g_shaderProgram.get_position_attribute());
-	glDisableVertexAttribArray(g_shaderProgram.get_tex_coordinate_attribute());
+bool nothing_moves() {
+	// paused, or the match is over and nobody is steering; the stress sprites never stop, and
+	// textures still decoding or uploading only finish when render() runs a frame
+	if (g_stressSpriteCount > 0) return false;
+	if (g_textureManager.has_pending_work() || g_atlasLoad.valid() || g_atlasUpload >= 0) return false;
+	if (g_paused) return true;
+	return g_gameOver && !g_vsAI && g_player1Dir == glm::vec2(0.0f) && g_player2Dir == glm::vec2(0.0f);
+}
 
-	SDL_GL_SwapWindow(g_displayWindow);
+void pace_frame() {
+	// an idle frame still wakes in time for the game over timer, so the match queue keeps going
+	if (g_idleMode && nothing_moves()) {
+		Uint32 timeout = IDLE_TIMEOUT_MS;
+		if (g_gameOver && !g_paused) timeout = std::min(timeout, (Uint32)(g_gameOverTimer * MILLISECONDS_IN_SECOND) + 1);
+		g_framePacer.idle(timeout);
+	} else {
+		g_framePacer.wait();
+	}
+}
+
+void start_low_latency() {
+	// adaptive vsync lets a frame that misses its vblank tear instead of waiting a whole refresh
+	bool adaptive = SDL_GL_SetSwapInterval(-1) == 0;
+	if (!adaptive) SDL_GL_SetSwapInterval(1);
+	SDL_DisplayMode mode;
+	int refreshHz = SDL_GetCurrentDisplayMode(0, &mode) == 0 && mode.refresh_rate > 0 ? mode.refresh_rate : DEFAULT_REFRESH_HZ;
+	g_framePacer.start_low_latency((float)refreshHz, LOW_LATENCY_MARGIN_MS);
+	std::cout << "low latency: " << (adaptive ? "adaptive vsync" : "vsync") << " at " << refreshHz << " Hz, frames start just in time for the next vblank" << std::endl;
 }
 
 void shutdown() {
+	if (!g_inputSampleAgeMs.empty()) report_input_age();
+	g_textureManager.cleanup();
+	g_textureUploader.cleanup();
+	g_assetPack.close();
+	g_inputQueue.cleanup();
+	g_spriteBatch.cleanup();
+	g_frameUniforms.cleanup();
 	SDL_Quit();
 }
 
 int main(int argc, char* argv[]) {
+	g_processStart = SDL_GetPerformanceCounter();
+
+	// "--stress <count>" draws that many extra sprites per frame and reports timings,
+	// "--async-upload" streams textures from a shared-context thread and
+	// "--upload-bench <count>" uploads that many large textures while timing every frame,
+	// "--loose-assets" ignores embedded and packed assets in favour of the files on disk,
+	// "--vram-budget <MB>" sets how much texture memory the manager keeps before evicting,
+	// "--upload-budget <ms>" caps the time spent streaming textures each frame without the upload thread,
+	// "--arena <png>" adds a background to the tab cycle,
+	// "--arena-bench <frames>" switches arenas every few frames and reports the frame times and
+	// "--match-queue" plays matches back to back until quit, for the arcade cabinets,
+	// "--fps <n>" holds the loop to n frames a second with a sleep-then-spin wait,
+	// "--idle" blocks on input instead of redrawing while paused or after a match ends,
+	// "--low-latency" syncs to vblank and starts each frame as late as it can still make the next one,
+	// "--late-latch" runs the sim up to the present, with any newer input, right before the sprites are drawn,
+	// "--input-report" prints percentiles of how old each frame's input is once it is presented,
+	// "--tick-rate <hz>" sets how often the fixed-step sim runs (default 240, at most 10000),
+	// "--input-poll-hz <hz>" keeps pumping events while the pacer waits, for finer key timestamps, and
+	// "--pacer-report" prints cpu use, frame time jitter and, with "--low-latency", input latency for the active mode
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--async-upload") == 0) g_asyncUpload = true;
+		if (strcmp(argv[i], "--loose-assets") == 0) g_looseAssets = true;
+		if (strcmp(argv[i], "--match-queue") == 0) g_matchQueue = true;
+		if (strcmp(argv[i], "--idle") == 0) g_idleMode = true;
+		if (strcmp(argv[i], "--pacer-report") == 0) g_pacerReport = true;
+		if (strcmp(argv[i], "--low-latency") == 0) g_lowLatency = true;
+		if (strcmp(argv[i], "--late-latch") == 0) g_lateLatch = true;
+		if (strcmp(argv[i], "--input-report") == 0) g_inputReport = true;
+		if (i + 1 >= argc) continue;
+		if (strcmp(argv[i], "--stress") == 0) g_stressSpriteCount = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--upload-bench") == 0) g_uploadBenchCount = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--vram-budget") == 0) g_vramBudgetMB = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--upload-budget") == 0) g_uploadBudgetMs = (float)atof(argv[i + 1]);
+		if (strcmp(argv[i], "--arena") == 0) g_arenaPaths.push_back(argv[i + 1]);
+		if (strcmp(argv[i], "--arena-bench") == 0) g_arenaBenchFrames = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--fps") == 0) g_targetFps = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--tick-rate") == 0) g_tickRate = std::min(std::max(1, atoi(argv[i + 1])), MAX_TICK_RATE);
+		if (strcmp(argv[i], "--input-poll-hz") == 0) g_inputPollHz = atoi(argv[i + 1]);
+	}
+
 	initialize();
+	g_framePacer.load(g_targetFps, PACER_SPIN_MS, g_pacerReport, PACER_REPORT_INTERVAL);
+	g_framePacer.set_input_poll(g_inputPollHz);
+	if (g_lowLatency) start_low_latency();
 	
 	while (g_gameIsRunning) {
+		g_framePacer.begin_frame();
 		processInput();
 		update();
 		render();
+		pace_frame();
 	}
 
 	shutdown();
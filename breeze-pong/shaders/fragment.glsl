@@ -1,5 +1,9 @@
+#version 330
+
 uniform vec4 color;
 
+out vec4 fragColor;
+
 void main() {
-    gl_FragColor = color;
+    fragColor = color;
 }
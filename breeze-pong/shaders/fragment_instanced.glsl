@@ -0,0 +1,11 @@
+#version 330
+
+uniform sampler2D diffuse;
+in vec2 texCoordVar;
+in vec4 tintVar;
+
+out vec4 fragColor;
+
+void main() {
+    fragColor = texture(diffuse, texCoordVar) * tintVar;
+}
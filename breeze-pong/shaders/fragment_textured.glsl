@@ -1,7 +1,10 @@
+#version 330
 
 uniform sampler2D diffuse;
-varying vec2 texCoordVar;
+in vec2 texCoordVar;
+
+out vec4 fragColor;
 
 void main() {
-    gl_FragColor = texture2D(diffuse, texCoordVar);
+    fragColor = texture(diffuse, texCoordVar);
 }
@@ -1,11 +1,19 @@
-attribute vec4 position;
+#version 330
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+in vec4 position;
+
+layout(std140) uniform FrameData
+{
+    mat4 projectionMatrix;
+    mat3x2 viewMatrix;
+    vec2 screenSize;
+    float time;
+};
+
+uniform mat3x2 modelMatrix;
 
 void main()
 {
-	vec4 p = viewMatrix * modelMatrix  * position;
-	gl_Position = projectionMatrix * p;
+	vec2 p = viewMatrix * vec3(modelMatrix * vec3(position.xy, 1.0), 1.0);
+	gl_Position = projectionMatrix * vec4(p, 0.0, 1.0);
 }
@@ -0,0 +1,35 @@
+#version 330
+
+in vec4 position;
+in vec2 texCoord;
+
+// per-instance: translate.xy, scale.xy, then rotation in radians
+in vec4 instanceTransform;
+in float instanceRotation;
+in vec4 instanceUVRect;
+in vec4 instanceTint;
+
+// 2D affine transforms are mat3x2; only the projection is a full mat4
+layout(std140) uniform FrameData
+{
+    mat4 projectionMatrix;
+    mat3x2 viewMatrix;
+    vec2 screenSize;
+    float time;
+};
+
+out vec2 texCoordVar;
+out vec4 tintVar;
+
+void main()
+{
+	// scale, rotate, then translate: the same transform the CPU used to build as a mat4
+	vec2 scaled = position.xy * instanceTransform.zw;
+	float c = cos(instanceRotation);
+	float s = sin(instanceRotation);
+	vec2 rotated = vec2(scaled.x * c - scaled.y * s, scaled.x * s + scaled.y * c);
+	vec2 p = viewMatrix * vec3(rotated + instanceTransform.xy, 1.0);
+    texCoordVar = instanceUVRect.xy + texCoord * instanceUVRect.zw;
+    tintVar = instanceTint;
+	gl_Position = projectionMatrix * vec4(p, 0.0, 1.0);
+}
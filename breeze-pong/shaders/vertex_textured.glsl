@@ -1,15 +1,23 @@
-attribute vec4 position;
-attribute vec2 texCoord;
+#version 330
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+in vec4 position;
+in vec2 texCoord;
 
-varying vec2 texCoordVar;
+layout(std140) uniform FrameData
+{
+    mat4 projectionMatrix;
+    mat3x2 viewMatrix;
+    vec2 screenSize;
+    float time;
+};
+
+uniform mat3x2 modelMatrix;
+
+out vec2 texCoordVar;
 
 void main()
 {
-	vec4 p = viewMatrix * modelMatrix  * position;
+	vec2 p = viewMatrix * vec3(modelMatrix * vec3(position.xy, 1.0), 1.0);
     texCoordVar = texCoord;
-	gl_Position = projectionMatrix * p;
-}
\ No newline at end of file
+	gl_Position = projectionMatrix * vec4(p, 0.0, 1.0);
+}
@@ -314,7 +314,8 @@ publish, and distribute this file as you see fit.
 //
 // The JPEG decoder will try to automatically use SIMD kernels on x86 when
 // supported by the compiler. For ARM Neon support, you must explicitly
-// request it.
+// request it. The PNG decoder reconstructs 8-bit RGB and RGBA scanlines with
+// SSE2 on x86 (the output is identical to the scalar path).
 //
 // (The old do-it-yourself SIMD API is no longer supported in the current
 // code.)
@@ -881,8 +882,23 @@ static stbi_uc *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
-// this is not threadsafe
-static const char *stbi__g_failure_reason;
+// thread-local where the compiler allows it, so decodes on several threads at once don't
+// overwrite each other's failure reason
+#ifndef STBI_THREAD_LOCAL
+   #if defined(__cplusplus)
+      #define STBI_THREAD_LOCAL thread_local
+   #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL _Thread_local
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL __declspec(thread)
+   #elif defined(__GNUC__)
+      #define STBI_THREAD_LOCAL __thread
+   #else
+      #define STBI_THREAD_LOCAL
+   #endif
+#endif
+
+static STBI_THREAD_LOCAL const char *stbi__g_failure_reason;
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -3584,13 +3600,30 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
    return *z->zbuffer++;
 }
 
-static void stbi__fill_bits(stbi__zbuf *z)
+// Tops the bit buffer up to at least 24 bits. With four input bytes left they are read
+// at once and only the whole bytes that fit are kept, instead of looping byte by byte
+// with an end check each time; past the end of the input it shifts in zeros.
+stbi_inline static void stbi__zrefill(stbi_uc **zbuffer, stbi_uc *zbuffer_end, stbi__uint32 *code_buffer, int *num_bits)
 {
+   STBI_ASSERT(*code_buffer < (1U << *num_bits));
+   if (zbuffer_end - *zbuffer >= 4) {
+      stbi_uc *p = *zbuffer;
+      stbi__uint32 v = p[0] | p[1] << 8 | p[2] << 16 | (stbi__uint32) p[3] << 24;
+      int bytes = (31 - *num_bits) >> 3;
+      *code_buffer |= (v << *num_bits) & ((1U << (*num_bits + bytes * 8)) - 1);
+      *zbuffer += bytes;
+      *num_bits += bytes * 8;
+      return;
+   }
    do {
-      STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
-      z->num_bits += 8;
-   } while (z->num_bits <= 24);
+      if (*zbuffer < zbuffer_end) *code_buffer |= (unsigned int) *(*zbuffer)++ << *num_bits;
+      *num_bits += 8;
+   } while (*num_bits <= 24);
+}
+
+static void stbi__fill_bits(stbi__zbuf *z)
+{
+   stbi__zrefill(&z->zbuffer, z->zbuffer_end, &z->code_buffer, &z->num_bits);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
@@ -3668,13 +3701,44 @@ static int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
 static int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// Looks a symbol up in the low bits of code_buffer, which must hold at least 16 bits;
+// sets size to the code length, returns -1 for an invalid code.
+stbi_inline static int stbi__zhuffman_lookup(stbi__zhuffman *z, stbi__uint32 code_buffer, int *size)
+{
+   int b = z->fast[code_buffer & STBI__ZFAST_MASK];
+   int s,k;
+   if (b) {
+      *size = b >> 9;
+      return b & 511;
+   }
+   k = stbi__bit_reverse(code_buffer & 0xffff, 16);
+   for (s=STBI__ZFAST_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s == 16) return -1; // invalid code!
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   STBI_ASSERT(z->size[b] == s);
+   *size = s;
+   return z->value[b];
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
+   // the bit reader lives in locals for the whole block: every output byte is a char store,
+   // which may alias the stbi__zbuf fields and would otherwise force them through memory
    char *zout = a->zout;
+   stbi_uc *zbuffer = a->zbuffer;
+   stbi__uint32 code_buffer = a->code_buffer;
+   int num_bits = a->num_bits;
+   #define STBI__ZCONSUME(n) (code_buffer >>= (n), num_bits -= (n))
+   #define STBI__ZSAVE()     (a->zbuffer = zbuffer, a->code_buffer = code_buffer, a->num_bits = num_bits)
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z,size;
+      if (num_bits < 16) stbi__zrefill(&zbuffer, a->zbuffer_end, &code_buffer, &num_bits);
+      z = stbi__zhuffman_lookup(&a->z_length, code_buffer, &size);
+      if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
+      STBI__ZCONSUME(size);
       if (z < 256) {
-         if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
             if (!stbi__zexpand(a, zout, 1)) return 0;
             zout = a->zout;
@@ -3685,15 +3749,27 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
          int len,dist;
          if (z == 256) {
             a->zout = zout;
+            STBI__ZSAVE();
             return 1;
          }
          z -= 257;
          len = stbi__zlength_base[z];
-         if (stbi__zlength_extra[z]) len += stbi__zreceive(a, stbi__zlength_extra[z]);
-         z = stbi__zhuffman_decode(a, &a->z_distance);
+         if (stbi__zlength_extra[z]) {
+            // at most 5 extra bits, then up to 15 for the distance code and 13 extra
+            if (num_bits < stbi__zlength_extra[z]) stbi__zrefill(&zbuffer, a->zbuffer_end, &code_buffer, &num_bits);
+            len += code_buffer & ((1 << stbi__zlength_extra[z]) - 1);
+            STBI__ZCONSUME(stbi__zlength_extra[z]);
+         }
+         if (num_bits < 16) stbi__zrefill(&zbuffer, a->zbuffer_end, &code_buffer, &num_bits);
+         z = stbi__zhuffman_lookup(&a->z_distance, code_buffer, &size);
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG");
+         STBI__ZCONSUME(size);
          dist = stbi__zdist_base[z];
-         if (stbi__zdist_extra[z]) dist += stbi__zreceive(a, stbi__zdist_extra[z]);
+         if (stbi__zdist_extra[z]) {
+            if (num_bits < stbi__zdist_extra[z]) stbi__zrefill(&zbuffer, a->zbuffer_end, &code_buffer, &num_bits);
+            dist += code_buffer & ((1 << stbi__zdist_extra[z]) - 1);
+            STBI__ZCONSUME(stbi__zdist_extra[z]);
+         }
          if (zout - a->zout_start < dist) return stbi__err("bad dist","Corrupt PNG");
          if (zout + len > a->zout_end) {
             if (!stbi__zexpand(a, zout, len)) return 0;
@@ -3703,11 +3779,23 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
          if (dist == 1) { // run of one byte; common in images.
             stbi_uc v = *p;
             if (len) { do *zout++ = v; while (--len); }
+         } else if (dist >= 8 && zout + len + 8 <= a->zout_end) {
+            // sources at least 8 back never overlap an 8-byte chunk of the destination;
+            // the last chunk may run up to 7 bytes past the match, which later output overwrites
+            char *end = zout + len;
+            do {
+               memcpy(zout, p, 8);
+               zout += 8;
+               p += 8;
+            } while (zout < end);
+            zout = end;
          } else {
             if (len) { do *zout++ = *p++; while (--len); }
          }
       }
    }
+   #undef STBI__ZCONSUME
+   #undef STBI__ZSAVE
 }
 
 static int stbi__compute_huffman_codes(stbi__zbuf *a)
@@ -3798,7 +3886,8 @@ static int stbi__parse_zlib_header(stbi__zbuf *a)
    return 1;
 }
 
-// @TODO: should statically initialize these for optimal thread safety
+// filled in on first use; callers decoding on several threads must make sure that first use
+// happens before the others start (ImageDecode.cpp does this with std::call_once)
 static stbi_uc stbi__zdefault_length[288], stbi__zdefault_distance[32];
 static void stbi__init_zdefaults(void)
 {
@@ -3999,6 +4088,98 @@ static int stbi__paeth(int a, int b, int c)
    return c;
 }
 
+#ifdef STBI_SSE2
+// Reconstructs a filtered 8-bit scanline after its first pixel, for 4-byte output pixels
+// (RGBA, or RGB expanded to RGBA when img_n == 3). Sub, avg and paeth depend on the pixel
+// to the left, so they go one pixel at a time with the channels in 16-bit lanes; Paeth uses p-a = b-c, p-b = a-c and p-c = a+b-2c, so it needs no
+// branches. Results match the scalar loops bit for bit.
+stbi_inline static __m128i stbi__load_pixel_sse2(const stbi_uc *p, int img_n, int last)
+{
+   // a 3-byte pixel is read as 4 and the spare byte ends up under the forced alpha,
+   // except at the end of a row, which may be the end of the buffer
+   int v = 0;
+   if (img_n == 3 && last) memcpy(&v, p, 3);
+   else                    memcpy(&v, p, 4);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static __m128i stbi__abs_epi16_sse2(__m128i x)
+{
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+stbi_inline static __m128i stbi__select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+   return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+stbi_inline static __m128i stbi__paeth_sse2(__m128i a, __m128i b, __m128i c)
+{
+   __m128i pa = stbi__abs_epi16_sse2(_mm_sub_epi16(b, c));
+   __m128i pb = stbi__abs_epi16_sse2(_mm_sub_epi16(a, c));
+   __m128i pc = stbi__abs_epi16_sse2(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+   __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+   // ties go to a, then b, as in stbi__paeth
+   __m128i predicted = stbi__select_sse2(_mm_cmpeq_epi16(smallest, pc), c, _mm_setzero_si128());
+   predicted = stbi__select_sse2(_mm_cmpeq_epi16(smallest, pb), b, predicted);
+   return stbi__select_sse2(_mm_cmpeq_epi16(smallest, pa), a, predicted);
+}
+
+static void stbi__defilter_row_sse2(int filter, stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int pixels, int img_n)
+{
+   // a and c are the reconstructed left pixel and the one above it, widened to 16 bits
+   __m128i zero = _mm_setzero_si128();
+   __m128i alpha = _mm_cvtsi32_si128(img_n == 4 ? 0 : (int) 0xff000000);
+   __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(int *) (cur - 4)), zero);
+   __m128i b, c, predicted, x;
+   int i;
+
+   #define STBI__SSE2_PIXEL_LOOP(predict) \
+      for (i=0; i < pixels; ++i, cur += 4, prior += 4, raw += img_n) { \
+         predict; \
+         x = _mm_add_epi8(stbi__load_pixel_sse2(raw, img_n, i == pixels - 1), _mm_packus_epi16(predicted, zero)); \
+         x = _mm_or_si128(x, alpha); \
+         *(int *) cur = _mm_cvtsi128_si32(x); \
+         a = _mm_unpacklo_epi8(x, zero); \
+      }
+   switch (filter) {
+      case STBI__F_none:
+         STBI__SSE2_PIXEL_LOOP(predicted = zero)
+         break;
+      case STBI__F_up:
+         if (img_n == 4) {
+            // no dependency on the left pixel, so whole vectors at a time
+            int n = pixels * 4;
+            for (i=0; i + 16 <= n; i += 16)
+               _mm_storeu_si128((__m128i *) (cur + i), _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw + i)), _mm_loadu_si128((__m128i *) (prior + i))));
+            for (; i < n; ++i)
+               cur[i] = STBI__BYTECAST(raw[i] + prior[i]);
+            break;
+         }
+         STBI__SSE2_PIXEL_LOOP(predicted = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(int *) prior), zero))
+         break;
+      case STBI__F_sub:
+      case STBI__F_paeth_first:
+         STBI__SSE2_PIXEL_LOOP(predicted = a)
+         break;
+      case STBI__F_avg_first:
+         STBI__SSE2_PIXEL_LOOP(predicted = _mm_srli_epi16(a, 1))
+         break;
+      case STBI__F_avg:
+         STBI__SSE2_PIXEL_LOOP(b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(int *) prior), zero);
+                               predicted = _mm_srli_epi16(_mm_add_epi16(a, b), 1))
+         break;
+      case STBI__F_paeth:
+         c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(int *) (prior - 4)), zero);
+         STBI__SSE2_PIXEL_LOOP(b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(int *) prior), zero);
+                               predicted = stbi__paeth_sse2(a, b, c);
+                               c = b)
+         break;
+   }
+   #undef STBI__SSE2_PIXEL_LOOP
+}
+#endif
+
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
@@ -4015,6 +4196,10 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int filter_bytes = img_n*bytes;
    int width = x;
 
+#ifdef STBI_SSE2
+   int use_sse2 = depth == 8 && out_n == 4 && stbi__sse2_available();
+#endif
+
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc(x * y * output_bytes); // extra bytes to write off the end into
    if (!a->out) return stbi__err("outofmem", "Out of memory");
@@ -4078,6 +4263,15 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          prior += 1;
       }
 
+#ifdef STBI_SSE2
+      // an unexpanded "none" row is already a memcpy below
+      if (use_sse2 && !(filter == STBI__F_none && img_n == out_n)) {
+         stbi__defilter_row_sse2(filter, cur, prior, raw, x - 1, img_n);
+         raw += (x - 1) * img_n;
+         continue;
+      }
+#endif
+
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
@@ -4570,8 +4764,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if ((c.type & (1 << 29)) == 0) {
                #ifndef STBI_NO_FAILURE_STRINGS
-               // not threadsafe
-               static char invalid_chunk[] = "XXXX PNG chunk not known";
+               static STBI_THREAD_LOCAL char invalid_chunk[] = "XXXX PNG chunk not known";
                invalid_chunk[0] = STBI__BYTECAST(c.type >> 24);
                invalid_chunk[1] = STBI__BYTECAST(c.type >> 16);
                invalid_chunk[2] = STBI__BYTECAST(c.type >>  8);
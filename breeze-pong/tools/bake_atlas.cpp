@@ -0,0 +1,76 @@
+/**
+* Offline sprite atlas baker.
+*
+* Packs the given images into the atlas format read by AtlasPacker::load_baked,
+* so the game starts without decoding any PNGs. With --compress the atlas is stored
+* as BC1/BC3 blocks instead of RGBA. Build and run from the
+* breeze-pong directory, since the stored paths must match the game's:
+*
+*   g++ -O2 -I. tools/bake_atlas.cpp AtlasPacker.cpp ImageDecode.cpp SourceStamp.cpp TextureCompression.cpp -o bake_atlas
+*   ./bake_atlas [--compress] assets/sprites.atlas assets/breeze_thin.png assets/wind_charge.png \
+*       assets/trial_chamber.png
+*
+* The win banners load on their own when a match ends, so they are left out (the asset
+* pack stores them as separate PNGs, see pack_assets.cpp).
+**/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "AtlasPacker.h"
+
+long file_size(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return 0;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+int main(int argc, char* argv[]) {
+	bool compress = argc > 1 && strcmp(argv[1], "--compress") == 0;
+	int first = compress ? 2 : 1;
+	if (argc < first + 2) {
+		std::cout << "usage: bake_atlas [--compress] <output.atlas> <image.png>..." << std::endl;
+		return 1;
+	}
+
+	AtlasPacker atlas;
+	long sourceBytes = 0;
+	for (int i = first + 1; i < argc; i++) {
+		if (atlas.add_image(argv[i]) < 0) return 1;
+		sourceBytes += file_size(argv[i]);
+	}
+	atlas.pack();
+
+	// compare the top level against the packed pixels to show what the blocks cost in quality;
+	// fully transparent pixels are skipped since their colour never shows
+	double rmse = 0.0;
+	if (compress) {
+		std::vector<unsigned char> original(atlas.get_pixels(), atlas.get_pixels() + atlas.get_atlas_bytes());
+		atlas.compress();
+		std::vector<unsigned char> decoded;
+		decompress_level(atlas.get_format(), atlas.get_levels()[0], decoded);
+		double squared = 0.0;
+		size_t samples = 0;
+		for (size_t i = 0; i < original.size(); i += 4) {
+			if (original[i + 3] == 0) continue;
+			for (int c = 0; c < 4; c++) squared += ((double)original[i + c] - decoded[i + c]) * ((double)original[i + c] - decoded[i + c]);
+			samples += 4;
+		}
+		rmse = samples > 0 ? std::sqrt(squared / samples) : 0.0;
+	}
+	if (!atlas.save(argv[first])) return 1;
+
+	std::cout << "baked " << atlas.get_entry_count() << " images into " << atlas.get_region_count()
+			  << " regions, " << atlas.get_width() << "x" << atlas.get_height() << " ("
+			  << atlas.get_atlas_bytes() / 1024 << " KB of VRAM, " << atlas.get_separate_bytes() / 1024
+			  << " KB as separate textures)" << std::endl;
+	std::cout << "on disk: " << file_size(argv[first]) / 1024 << " KB (" << sourceBytes / 1024 << " KB of source PNGs)" << std::endl;
+	if (compress) {
+		const char* formatName = atlas.get_format() == TEXTURE_FORMAT_BC1 ? "BC1" : "BC3";
+		std::cout << formatName << ", RMSE over visible pixels " << rmse << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,82 @@
+/**
+* Startup decode benchmark: stbi_load plus two copies vs decode_image_copy's one.
+*
+* Both modes let stb_image decode into its own buffer first; they only differ in how the
+* pixels reach the upload buffer. "twice" reproduces the old path: the image is copied into
+* a vector, then copied again into the upload buffer. "once" sizes the upload buffer from
+* the PNG header and has decode_image_copy copy the image straight over. Peak RSS only ever
+* grows, so run each mode in its own process. Build and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/decode_bench.cpp ImageDecode.cpp -o decode_bench
+*   ./decode_bench twice assets/trial_chamber.png ...
+*   ./decode_bench once assets/trial_chamber.png ...
+**/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "ImageDecode.h"
+#include "stb_image.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+long peak_rss_kb() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3 || (strcmp(argv[1], "twice") != 0 && strcmp(argv[1], "once") != 0)) {
+		std::cout << "usage: decode_bench <twice|once> <image.png>..." << std::endl;
+		return 1;
+	}
+	bool once = strcmp(argv[1], "once") == 0;
+	long baseline = peak_rss_kb();
+
+	// the upload buffers stand in for mapped pixel-unpack buffers and stay alive, like textures would
+	std::vector<unsigned char*> uploads;
+	size_t bytes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 2; i < argc; i++) {
+		int width, height;
+		if (once) {
+			if (!query_image_size(argv[i], width, height)) return 1;
+			size_t size = (size_t)width * height * 4;
+			unsigned char* upload = (unsigned char*)malloc(size);
+			if (!decode_image_copy(argv[i], upload, size)) return 1;
+			uploads.push_back(upload);
+			bytes += size;
+		} else {
+			int numOfComponents;
+			unsigned char* pixels = stbi_load(argv[i], &width, &height, &numOfComponents, STBI_rgb_alpha);
+			if (pixels == NULL) return 1;
+			size_t size = (size_t)width * height * 4;
+			std::vector<unsigned char> decoded(pixels, pixels + size);
+			stbi_image_free(pixels);
+			unsigned char* upload = (unsigned char*)malloc(size);
+			memcpy(upload, decoded.data(), size);
+			uploads.push_back(upload);
+			bytes += size;
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << argv[1] << ": " << argc - 2 << " images, " << bytes / 1024 << " KB of pixels, "
+			  << ms << " ms, peak RSS " << peak_rss_kb() << " KB (+" << peak_rss_kb() - baseline << " KB)" << std::endl;
+	for (unsigned char* upload : uploads) free(upload);
+	return 0;
+}
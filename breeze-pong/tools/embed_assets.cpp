@@ -0,0 +1,56 @@
+/**
+* Asset embedding build step.
+*
+* Turns an asset pack into a constexpr byte array that EmbeddedAssets.cpp compiles
+* into the game when BREEZE_EMBED_ASSETS is defined. The compressed pack keeps the
+* generated source, and the compile, small. Build and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/pack_assets.cpp AssetPack.cpp AtlasPacker.cpp ImageDecode.cpp SourceStamp.cpp TextureCompression.cpp -o pack_assets
+*   g++ -O2 tools/embed_assets.cpp -o embed_assets
+*   ./pack_assets --compress assets/breeze.pack assets/breeze_thin.png assets/wind_charge.png \
+*       assets/trial_chamber.png shaders/vertex_instanced.glsl shaders/fragment_instanced.glsl \
+*       --separate assets/player_1_wins.png assets/player_2_wins.png
+*   ./embed_assets assets/breeze.pack assets/embedded_pack.inc
+**/
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// matches AssetPack::ASSET_PACK_ALIGNMENT, so blobs stay aligned inside the array
+const int EMBED_ALIGNMENT = 16;
+const int BYTES_PER_LINE = 24;
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		std::cout << "usage: embed_assets <input.pack> <output.inc>" << std::endl;
+		return 1;
+	}
+
+	FILE* input = fopen(argv[1], "rb");
+	if (input == NULL) {
+		std::cout << "Unable to read '" << argv[1] << "'." << std::endl;
+		return 1;
+	}
+	std::vector<unsigned char> pack;
+	unsigned char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), input)) > 0) pack.insert(pack.end(), buffer, buffer + read);
+	fclose(input);
+
+	FILE* output = fopen(argv[2], "w");
+	if (output == NULL) {
+		std::cout << "Unable to write '" << argv[2] << "'." << std::endl;
+		return 1;
+	}
+	fprintf(output, "// generated by tools/embed_assets.cpp from %s, do not edit\n", argv[1]);
+	fprintf(output, "alignas(%d) constexpr unsigned char EMBEDDED_ASSET_PACK[%zu] = {\n", EMBED_ALIGNMENT, pack.size());
+	for (size_t i = 0; i < pack.size(); i++) {
+		fprintf(output, "%s%u,%s", i % BYTES_PER_LINE == 0 ? "    " : "", pack[i], i % BYTES_PER_LINE == BYTES_PER_LINE - 1 ? "\n" : "");
+	}
+	fprintf(output, "\n};\n");
+	fclose(output);
+
+	std::cout << "embedded " << pack.size() / 1024 << " KB from " << argv[1] << " into " << argv[2] << std::endl;
+	return 0;
+}
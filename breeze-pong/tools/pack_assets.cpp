@@ -0,0 +1,82 @@
+/**
+* Asset pack builder.
+*
+* Bakes every PNG argument into one sprite atlas (stored under the game's
+* ATLAS_PATH, optionally BC1/BC3 compressed) and stores every other file, such as
+* shader sources, byte for byte under its own path. PNGs after --separate are stored
+* byte for byte as well, for textures the game loads on their own like the win
+* banners. The game maps the result at startup instead of opening loose files. Build
+* and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/pack_assets.cpp AssetPack.cpp AtlasPacker.cpp ImageDecode.cpp SourceStamp.cpp TextureCompression.cpp -o pack_assets
+*   ./pack_assets [--compress] assets/breeze.pack assets/breeze_thin.png assets/wind_charge.png \
+*       assets/trial_chamber.png shaders/vertex_instanced.glsl shaders/fragment_instanced.glsl \
+*       --separate assets/player_1_wins.png assets/player_2_wins.png
+**/
+
+#include <cstdio>
+#include <cstring>
+#include "AssetPack.h"
+#include "AtlasPacker.h"
+
+// must match ATLAS_PATH in main.cpp
+const char ATLAS_NAME[] = "assets/sprites.atlas";
+
+bool read_file(const char* path, std::vector<unsigned char>& contents) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		std::cout << "Unable to read '" << path << "'." << std::endl;
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	contents.resize((size_t)ftell(file));
+	fseek(file, 0, SEEK_SET);
+	bool read = fread(contents.data(), 1, contents.size(), file) == contents.size();
+	fclose(file);
+	return read;
+}
+
+int main(int argc, char* argv[]) {
+	bool compress = argc > 1 && strcmp(argv[1], "--compress") == 0;
+	int first = compress ? 2 : 1;
+	if (argc < first + 2) {
+		std::cout << "usage: pack_assets [--compress] <output.pack> <file>... [--separate <file>...]" << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> names;
+	std::vector<std::vector<unsigned char>> blobs;
+	AtlasPacker atlas;
+	bool separate = false;
+	for (int i = first + 1; i < argc; i++) {
+		if (strcmp(argv[i], "--separate") == 0) {
+			separate = true;
+			continue;
+		}
+		size_t length = strlen(argv[i]);
+		if (!separate && length > 4 && strcmp(argv[i] + length - 4, ".png") == 0) {
+			if (atlas.add_image(argv[i]) < 0) return 1;
+			continue;
+		}
+		names.push_back(argv[i]);
+		blobs.push_back(std::vector<unsigned char>());
+		if (!read_file(argv[i], blobs.back())) return 1;
+	}
+
+	if (atlas.get_entry_count() > 0) {
+		atlas.pack();
+		if (compress) atlas.compress();
+		names.push_back(ATLAS_NAME);
+		blobs.push_back(std::vector<unsigned char>());
+		atlas.serialize(blobs.back());
+	}
+	if (!AssetPack::write(argv[first], names, blobs)) return 1;
+
+	for (size_t i = 0; i < names.size(); i++) {
+		std::cout << "  " << names[i] << ": " << blobs[i].size() / 1024 << " KB" << std::endl;
+	}
+	AssetPack pack;
+	pack.open(argv[first]);
+	std::cout << "packed " << pack.get_entry_count() << " entries into " << argv[first] << ", " << pack.get_size() / 1024 << " KB" << std::endl;
+	return 0;
+}
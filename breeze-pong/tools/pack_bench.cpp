@@ -0,0 +1,94 @@
+/**
+* Startup asset benchmark: loose files vs a baked atlas vs the mapped asset pack, and
+* the pack compiled into the binary when built with BREEZE_EMBED_ASSETS.
+*
+* Times everything the game does before its first GL upload: loose mode decodes and
+* packs the PNGs and streams the shaders through std::ifstream, baked mode reads
+* assets/sprites.atlas instead of the PNGs, and pack mode maps the pack and points the
+* atlas and shaders into it. Every pixel is summed at the end, standing in for the
+* driver reading the upload, so the mapping's page faults are counted too. Build the
+* pack with pack_assets first, then run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/pack_bench.cpp AssetPack.cpp AtlasPacker.cpp ImageDecode.cpp SourceStamp.cpp TextureCompression.cpp \
+*       EmbeddedAssets.cpp [-DBREEZE_EMBED_ASSETS] -o pack_bench
+*   ./pack_bench [rounds]
+**/
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "AssetPack.h"
+#include "AtlasPacker.h"
+#include "EmbeddedAssets.h"
+
+const char* const SPRITE_PATHS[] = { "assets/breeze_thin.png", "assets/wind_charge.png", "assets/player_1_wins.png",
+									 "assets/player_2_wins.png", "assets/trial_chamber.png" };
+const char* const SHADER_PATHS[] = { "shaders/vertex_instanced.glsl", "shaders/fragment_instanced.glsl" };
+const char ATLAS_PATH[] = "assets/sprites.atlas";
+const char PACK_PATH[] = "assets/breeze.pack";
+
+size_t touch(const AtlasPacker& atlas) {
+	const unsigned char* pixels = atlas.get_format() == TEXTURE_FORMAT_RGBA8 ? atlas.get_pixels() : atlas.get_levels()[0].data;
+	size_t sum = 0;
+	for (size_t i = 0; i < atlas.get_atlas_bytes() && pixels != NULL; i += 64) sum += pixels[i];
+	return sum;
+}
+
+size_t read_shaders_loose() {
+	size_t bytes = 0;
+	for (const char* path : SHADER_PATHS) {
+		std::ifstream infile(path);
+		std::stringstream buffer;
+		buffer << infile.rdbuf();
+		bytes += buffer.str().size();
+	}
+	return bytes;
+}
+
+size_t run(int mode) {
+	if (mode >= 2) {
+		AssetPack pack;
+		size_t embeddedSize;
+		const unsigned char* embedded = get_embedded_asset_pack(embeddedSize);
+		if (mode == 2 ? !pack.open(PACK_PATH) : !pack.open_memory(embedded, embeddedSize)) exit(1);
+		const unsigned char* data;
+		size_t size, bytes = 0;
+		for (const char* path : SHADER_PATHS) {
+			if (pack.find(path, data, size)) bytes += std::string((const char*)data, size).size();
+		}
+		AtlasPacker atlas;
+		if (!pack.find(ATLAS_PATH, data, size) || !atlas.load_baked(data, size)) exit(1);
+		return bytes + touch(atlas);
+	}
+
+	AtlasPacker atlas;
+	if (mode == 1) {
+		if (!atlas.load_baked(ATLAS_PATH)) exit(1);
+	} else {
+		for (const char* path : SPRITE_PATHS) atlas.add_image(path);
+		atlas.pack();
+	}
+	return read_shaders_loose() + touch(atlas);
+}
+
+int main(int argc, char* argv[]) {
+	int rounds = argc > 1 ? atoi(argv[1]) : 20;
+	const char* const MODE_NAMES[] = { "loose PNGs", "baked atlas", "asset pack", "embedded pack" };
+	size_t embeddedSize;
+	int modes = get_embedded_asset_pack(embeddedSize) != NULL ? 4 : 3;
+	size_t checksum = 0;
+	for (int mode = 0; mode < modes; mode++) {
+		double best = 1e9, total = 0.0;
+		for (int round = 0; round < rounds; round++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			checksum += run(mode);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = ms < best ? ms : best;
+			total += ms;
+		}
+		std::cout << MODE_NAMES[mode] << ": best " << best << " ms, mean " << total / rounds << " ms" << std::endl;
+	}
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,275 @@
+/**
+* PNG decode benchmark for the bundled stb_image.
+*
+* Decodes each file, plus three synthetic images, from memory a number of times and
+* prints the median time and a hash of the pixels. The synthetic images are built here
+* with a small fixed-Huffman deflate encoder: a noisy gradient as RGBA and as RGB, both
+* Paeth-filtered, and an RGBA image that cycles through all five filters row by row.
+* Build it twice, once with -DSTBI_NO_SIMD, and compare the times; the hashes
+* must be identical. Build and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/png_bench.cpp ImageDecode.cpp -o png_bench
+*   g++ -O2 -I. -DSTBI_NO_SIMD tools/png_bench.cpp ImageDecode.cpp -o png_bench_scalar
+*   ./png_bench [--iterations 20] [--size 2048] assets/trial_chamber.png assets/player_1_wins.png ...
+**/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "ImageDecode.h"
+#include "stb_image.h"
+
+const int DEFAULT_ITERATIONS = 20;
+const int DEFAULT_SYNTHETIC_SIZE = 2048;
+const int FILTER_CYCLE = -1;	// filter argument for the image that uses every filter in turn
+
+// deflate match limits
+const int MIN_MATCH = 3, MAX_MATCH = 258, WINDOW_SIZE = 32768;
+const int HASH_BITS = 15;
+
+struct BitWriter {
+	std::vector<unsigned char> bytes;
+	unsigned int buffer = 0;
+	int count = 0;
+
+	void write(unsigned int bits, int length) {
+		buffer |= bits << count;
+		count += length;
+		while (count >= 8) {
+			bytes.push_back((unsigned char)buffer);
+			buffer >>= 8;
+			count -= 8;
+		}
+	}
+
+	// Huffman codes go out most significant bit first
+	void write_code(unsigned int code, int length) {
+		unsigned int reversed = 0;
+		for (int i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+		write(reversed, length);
+	}
+
+	void flush() {
+		if (count > 0) bytes.push_back((unsigned char)buffer);
+		buffer = 0;
+		count = 0;
+	}
+};
+
+const int LENGTH_BASE[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+const int LENGTH_EXTRA[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+const int DIST_BASE[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+const int DIST_EXTRA[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+void write_literal_length(BitWriter& out, int symbol) {
+	if (symbol < 144) out.write_code(0x30 + symbol, 8);
+	else if (symbol < 256) out.write_code(0x190 + symbol - 144, 9);
+	else if (symbol < 280) out.write_code(symbol - 256, 7);
+	else out.write_code(0xC0 + symbol - 280, 8);
+}
+
+void write_match(BitWriter& out, int length, int distance) {
+	int code = 28;
+	while (LENGTH_BASE[code] > length) code--;
+	write_literal_length(out, 257 + code);
+	out.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+	code = 29;
+	while (DIST_BASE[code] > distance) code--;
+	out.write_code(code, 5);
+	out.write(distance - DIST_BASE[code], DIST_EXTRA[code]);
+}
+
+// one fixed-Huffman block with greedy single-candidate LZ77 matching, wrapped as zlib
+std::vector<unsigned char> zlib_compress(const std::vector<unsigned char>& data) {
+	BitWriter out;
+	out.write(0x78, 8);
+	out.write(0x01, 8);
+	out.write(1, 1);	// final block
+	out.write(1, 2);	// fixed Huffman codes
+
+	std::vector<int> head(1 << HASH_BITS, -1);
+	size_t size = data.size();
+	for (size_t i = 0; i < size;) {
+		int length = 0, distance = 0;
+		if (i + MIN_MATCH <= size) {
+			unsigned int hash = ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - HASH_BITS);
+			int candidate = head[hash];
+			head[hash] = (int)i;
+			if (candidate >= 0 && i - candidate <= WINDOW_SIZE) {
+				size_t limit = std::min((size_t)MAX_MATCH, size - i);
+				while ((size_t)length < limit && data[candidate + length] == data[i + length]) length++;
+				distance = (int)(i - candidate);
+			}
+		}
+		if (length >= MIN_MATCH) {
+			write_match(out, length, distance);
+			i += length;
+		} else {
+			write_literal_length(out, data[i]);
+			i++;
+		}
+	}
+	write_literal_length(out, 256);
+	out.flush();
+
+	unsigned int a = 1, b = 0;
+	for (unsigned char byte : data) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	unsigned int adler = b << 16 | a;
+	for (int shift = 24; shift >= 0; shift -= 8) out.bytes.push_back((unsigned char)(adler >> shift));
+	return out.bytes;
+}
+
+unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc = 0) {
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc ^= data[i];
+		for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+	}
+	return ~crc;
+}
+
+void append_u32(std::vector<unsigned char>& out, unsigned int value) {
+	for (int shift = 24; shift >= 0; shift -= 8) out.push_back((unsigned char)(value >> shift));
+}
+
+void append_chunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data) {
+	append_u32(png, (unsigned int)data.size());
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	append_u32(png, crc32(&png[start], png.size() - start));
+}
+
+int paeth(int a, int b, int c) {
+	int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	return pb <= pc ? b : c;
+}
+
+std::vector<unsigned char> make_synthetic_png(int size, int channels, int filter) {
+	// a smooth gradient with a little noise and some flat bands, so both literals and matches show up
+	std::vector<unsigned char> pixels((size_t)size * size * channels);
+	unsigned int seed = 12345;
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			seed = seed * 1103515245 + 12345;
+			int noise = (seed >> 16) % 7 - 3;
+			bool flat = (y / 64) % 4 == 3;
+			unsigned char* pixel = &pixels[((size_t)y * size + x) * channels];
+			pixel[0] = (unsigned char)(flat ? 40 : x * 255 / size + noise);
+			pixel[1] = (unsigned char)(flat ? 90 : y * 255 / size + noise);
+			pixel[2] = (unsigned char)(flat ? 140 : (x + y) * 127 / size + noise);
+			if (channels == 4) pixel[3] = (unsigned char)(flat ? 255 : 255 - (x * 64 / size));
+		}
+	}
+
+	size_t stride = (size_t)size * channels;
+	std::vector<unsigned char> filtered;
+	filtered.reserve((stride + 1) * size);
+	for (int y = 0; y < size; y++) {
+		int rowFilter = filter == FILTER_CYCLE ? y % 5 : filter;
+		filtered.push_back((unsigned char)rowFilter);
+		const unsigned char* row = &pixels[y * stride];
+		const unsigned char* prior = y > 0 ? row - stride : NULL;
+		for (size_t i = 0; i < stride; i++) {
+			int a = i >= (size_t)channels ? row[i - channels] : 0;
+			int b = prior != NULL ? prior[i] : 0;
+			int c = prior != NULL && i >= (size_t)channels ? prior[i - channels] : 0;
+			int predicted = 0;
+			switch (rowFilter) {
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) >> 1; break;
+				case 4: predicted = paeth(a, b, c); break;
+			}
+			filtered.push_back((unsigned char)(row[i] - predicted));
+		}
+	}
+
+	const unsigned char SIGNATURE[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	std::vector<unsigned char> png(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+	std::vector<unsigned char> header;
+	append_u32(header, size);
+	append_u32(header, size);
+	header.push_back(8);						// bit depth
+	header.push_back(channels == 4 ? 6 : 2);	// colour type
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	append_chunk(png, "IHDR", header);
+	append_chunk(png, "IDAT", zlib_compress(filtered));
+	append_chunk(png, "IEND", std::vector<unsigned char>());
+	return png;
+}
+
+bool read_file(const char* path, std::vector<unsigned char>& data) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return false;
+	fseek(file, 0, SEEK_END);
+	data.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+	return ok;
+}
+
+void bench(const std::string& name, const std::vector<unsigned char>& png, int iterations) {
+	std::vector<double> times;
+	unsigned long long hash = 14695981039346656037ull;
+	int width = 0, height = 0;
+	for (int i = 0; i < iterations; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int channels;
+		unsigned char* pixels = stbi_load_from_memory(png.data(), (int)png.size(), &width, &height, &channels, 4);
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		if (pixels == NULL) {
+			printf("%s: %s\n", name.c_str(), stbi_failure_reason());
+			return;
+		}
+		if (i == 0) {
+			for (size_t k = 0; k < (size_t)width * height * 4; k++) hash = (hash ^ pixels[k]) * 1099511628211ull;
+		}
+		stbi_image_free(pixels);
+	}
+	std::sort(times.begin(), times.end());
+	double median = times[times.size() / 2];
+	double megapixels = (double)width * height / 1e6;
+	printf("%-30s %5dx%-5d %8.2f ms %7.1f MP/s  %016llx\n", name.c_str(), width, height, median, megapixels / median * 1000.0, hash);
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = DEFAULT_ITERATIONS, size = DEFAULT_SYNTHETIC_SIZE;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) size = atoi(argv[++i]);
+		else paths.push_back(argv[i]);
+	}
+
+#ifdef STBI_NO_SIMD
+	printf("stb_image scalar, median of %d decodes\n", iterations);
+#else
+	printf("stb_image SIMD, median of %d decodes\n", iterations);
+#endif
+	for (const char* path : paths) {
+		std::vector<unsigned char> png;
+		if (!read_file(path, png)) {
+			printf("%s: could not read\n", path);
+			continue;
+		}
+		bench(path, png, iterations);
+	}
+
+	std::string suffix = " " + std::to_string(size);
+	bench("synthetic RGBA paeth" + suffix, make_synthetic_png(size, 4, 4), iterations);
+	bench("synthetic RGB paeth" + suffix, make_synthetic_png(size, 3, 4), iterations);
+	bench("synthetic RGBA all filters" + suffix, make_synthetic_png(size, 4, FILTER_CYCLE), iterations);
+	return 0;
+}
@@ -0,0 +1,97 @@
+/**
+* Checks for texture manager slots that are released while their decode is still running.
+*
+* A prefetch released before its decode finishes must be freed once the decode lands, not
+* parked as DECODED with nobody to release it, and it must not borrow (and so pin) a live
+* texture with the same pixels. The win banners hit this on every match. Needs a GL 3.3
+* context, which it opens on a hidden window. Build and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. $(sdl2-config --cflags) tools/texture_check.cpp TextureManager.cpp TextureUploader.cpp GLStateCache.cpp \
+*       AssetPack.cpp AtlasPacker.cpp ImageDecode.cpp SourceStamp.cpp TextureCompression.cpp $(sdl2-config --libs) -lGL -o texture_check
+*   ./texture_check
+**/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include "TextureManager.h"
+
+const char* const IMAGE_PATH = "assets/wind_charge.png";
+const char* const COPY_PATH = "texture_check_copy.png";
+
+int g_failures = 0;
+
+void check(bool passed, const char* what) {
+	printf("%s: %s\n", passed ? "ok  " : "FAIL", what);
+	if (!passed) g_failures++;
+}
+
+// runs frames until nothing is loading, drawing the given texture each frame so a zero
+// budget never evicts it
+void settle(TextureManager& manager, TextureHandle drawn) {
+	for (int frame = 0; frame < 1000 && manager.has_pending_work(); frame++) {
+		manager.get(drawn);
+		manager.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	manager.get(drawn);
+	manager.update();
+}
+
+int main(int argc, char* argv[]) {
+	SDL_Init(SDL_INIT_VIDEO);
+	SDL_Window* window = SDL_CreateWindow("texture_check", 0, 0, 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GLContext context = window != NULL ? SDL_GL_CreateContext(window) : NULL;
+	if (context == NULL) {
+		printf("no GL 3.3 context: %s\n", SDL_GetError());
+		return 1;
+	}
+#ifdef _WINDOWS
+	glewExperimental = GL_TRUE;
+	glewInit();
+#endif
+
+	// a byte-for-byte copy under another name, so the two dedupe against each other
+	{
+		std::ifstream source(IMAGE_PATH, std::ios::binary);
+		std::ofstream copy(COPY_PATH, std::ios::binary);
+		copy << source.rdbuf();
+	}
+
+	// with no VRAM budget anything not drawn this frame is evicted, or freed once unreferenced;
+	// no uploader, so uploads stream in on this thread
+	TextureManager manager;
+	manager.load(NULL, 0, 100.0f);
+	TextureHandle none = { 0, 0 };
+
+	// prefetch -> release before the decode finishes -> update
+	TextureHandle dropped = manager.prefetch(IMAGE_PATH);
+	manager.release(dropped);
+	settle(manager, none);
+	check(manager.get_state(dropped) == TEXTURE_EMPTY, "a prefetch released while decoding is freed when the decode lands");
+	check(!manager.has_pending_work() && manager.get_resident_bytes() == 0, "and leaves nothing loading or resident behind");
+
+	// the same, while a live texture has the same pixels
+	TextureHandle live = manager.acquire(IMAGE_PATH);
+	settle(manager, live);
+	check(manager.get_state(live) == TEXTURE_RESIDENT, "the original loads");
+	TextureHandle copy = manager.prefetch(COPY_PATH);
+	manager.release(copy);
+	settle(manager, live);
+	check(manager.get_dedupe_hits() == 0, "a released prefetch doesn't alias a live texture");
+	manager.release(live);
+	manager.update();
+	check(manager.get_state(live) == TEXTURE_EMPTY, "so the original is freed once released, not pinned");
+
+	manager.cleanup();
+	remove(COPY_PATH);
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+	printf("%d failed\n", g_failures);
+	return g_failures == 0 ? 0 : 1;
+}
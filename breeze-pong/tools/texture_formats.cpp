@@ -0,0 +1,70 @@
+/**
+* Per-asset VRAM report for the narrow texture formats.
+*
+* Decodes each image, picks the format the texture manager would store it in (R8 for
+* opaque grey, RG8 for grey plus alpha, RGBA8 otherwise), checks that expanding it back
+* gives the original pixels exactly and prints the VRAM it saves over RGBA8. Images with
+* at most 256 colours also show what an 8-bit index texture plus palette would take.
+* Build and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/texture_formats.cpp AtlasPacker.cpp ImageDecode.cpp SourceStamp.cpp TextureCompression.cpp -o texture_formats
+*   ./texture_formats assets/breeze_thin.png assets/wind_charge.png assets/player_1_wins.png \
+*       assets/player_2_wins.png assets/trial_chamber.png
+**/
+
+#include <cstdio>
+#include <set>
+#include <vector>
+#include "AtlasPacker.h"
+#include "TextureCompression.h"
+
+const int MAX_PALETTE_COLOURS = 256;
+const char* const FORMAT_NAMES[] = { "RGBA8", "BC1", "BC3", "R8", "RG8" };
+
+int count_colours(const DecodedImage& image) {
+	std::set<uint32_t> colours;
+	for (size_t i = 0; i < image.pixels.size() && (int)colours.size() <= MAX_PALETTE_COLOURS; i += 4) {
+		const unsigned char* pixel = &image.pixels[i];
+		colours.insert((uint32_t)pixel[0] | pixel[1] << 8 | pixel[2] << 16 | (uint32_t)pixel[3] << 24);
+	}
+	return (int)colours.size();
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printf("usage: texture_formats <image>...\n");
+		return 1;
+	}
+
+	size_t totalRGBA = 0, totalStored = 0;
+	for (int i = 1; i < argc; i++) {
+		DecodedImage image;
+		if (!AtlasPacker::decode_image(argv[i], image)) {
+			printf("%s: could not decode\n", argv[i]);
+			continue;
+		}
+
+		TextureFormat format = choose_channel_format(image.pixels.data(), image.width, image.height);
+		std::vector<unsigned char> stored(image.pixels);
+		pack_channels(format, stored.data(), image.width, image.height, stored.data());
+		stored.resize(texture_level_size(format, image.width, image.height));
+
+		TextureLevel level = { image.width, image.height, stored.data(), stored.size() };
+		std::vector<unsigned char> expanded;
+		decompress_level(format, level, expanded);
+
+		size_t rgbaBytes = image.pixels.size();
+		printf("%-28s %4dx%-4d %-5s %6zu KB -> %5zu KB, saves %5zu KB, %s", argv[i], image.width, image.height, FORMAT_NAMES[format],
+			   rgbaBytes / 1024, stored.size() / 1024, (rgbaBytes - stored.size()) / 1024, expanded == image.pixels ? "exact" : "MISMATCH");
+		int colours = count_colours(image);
+		if (colours <= MAX_PALETTE_COLOURS) {
+			size_t paletted = (size_t)image.width * image.height + colours * 4;
+			printf(", %d colours: index + palette would be %zu KB", colours, paletted / 1024);
+		}
+		printf("\n");
+		totalRGBA += rgbaBytes;
+		totalStored += stored.size();
+	}
+	printf("total: %zu KB -> %zu KB\n", totalRGBA / 1024, totalStored / 1024);
+	return 0;
+}
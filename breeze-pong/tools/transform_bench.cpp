@@ -0,0 +1,79 @@
+/**
+* Transform throughput benchmark: mat4 vs the 2D affine Transform2D.
+*
+* Builds a translate/rotate/scale transform per entity and composes it with a
+* camera transform, once with glm::mat4 and once with Transform2D and the batched
+* compose_transforms_2d. Build and run from the breeze-pong directory:
+*
+*   g++ -O2 -I. tools/transform_bench.cpp Transform2D.cpp -o transform_bench
+*   ./transform_bench [entity count]
+**/
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "Transform2D.h"
+
+const int ROUNDS = 100;
+
+double elapsed_ns(std::chrono::steady_clock::time_point start, int count) {
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS / count;
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? atoi(argv[1]) : 100000;
+
+	std::vector<glm::vec2> positions(count), scales(count);
+	std::vector<float> rotations(count);
+	for (int i = 0; i < count; i++) {
+		positions[i] = glm::vec2((float)rand() / RAND_MAX * 10.0f - 5.0f, (float)rand() / RAND_MAX * 7.5f - 3.75f);
+		scales[i] = glm::vec2(0.8f, 0.8f);
+		rotations[i] = (float)rand() / RAND_MAX * 6.28f;
+	}
+
+	// mat4 path, as update() used to do per sprite
+	glm::mat4 view4 = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -0.25f, 0.0f));
+	std::vector<glm::mat4> world4(count);
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < ROUNDS; round++) {
+		for (int i = 0; i < count; i++) {
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(positions[i], 0.0f));
+			model = glm::rotate(model, rotations[i], glm::vec3(0.0f, 0.0f, 1.0f));
+			model = glm::scale(model, glm::vec3(scales[i], 0.0f));
+			world4[i] = view4 * model;
+		}
+	}
+	double mat4Ns = elapsed_ns(start, count);
+
+	// 2D affine path: build locals, then compose the whole array in one batch
+	Transform2D view2 = make_transform_2d(glm::vec2(0.5f, -0.25f), glm::vec2(1.0f), 0.0f);
+	std::vector<Transform2D> local2(count), world2(count);
+	start = std::chrono::steady_clock::now();
+	for (int round = 0; round < ROUNDS; round++) {
+		for (int i = 0; i < count; i++) local2[i] = make_transform_2d(positions[i], scales[i], rotations[i]);
+		compose_transforms_2d(view2, local2.data(), world2.data(), count);
+	}
+	double affineNs = elapsed_ns(start, count);
+
+	// composition alone, which is the part that runs every frame for static entities
+	start = std::chrono::steady_clock::now();
+	for (int round = 0; round < ROUNDS; round++) {
+		compose_transforms_2d(view2, local2.data(), world2.data(), count);
+	}
+	double composeNs = elapsed_ns(start, count);
+
+	// both paths must agree on where a point ends up
+	glm::vec4 check4 = world4[count / 2] * glm::vec4(0.5f, 0.5f, 0.0f, 1.0f);
+	glm::vec2 check2 = transform_point_2d(world2[count / 2], glm::vec2(0.5f, 0.5f));
+
+	std::cout << count << " entities" << std::endl;
+	std::cout << "mat4:        " << sizeof(glm::mat4) << " bytes/entity, " << mat4Ns << " ns/transform" << std::endl;
+	std::cout << "Transform2D: " << sizeof(Transform2D) << " bytes/entity, " << affineNs << " ns/transform ("
+			  << composeNs << " ns batched compose only)" << std::endl;
+	std::cout << "max difference: " << glm::max(std::abs(check4.x - check2.x), std::abs(check4.y - check2.y)) << std::endl;
+	return 0;
+}